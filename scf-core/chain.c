@@ -0,0 +1,174 @@
+//
+//  chain.c
+//  scafell
+//
+
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "chain.h"
+#include "err_handling.h"
+
+/*
+ * Large enough to make each writev worthwhile without putting much on
+ * the stack.
+ */
+#define WRITE_IOV_COUNT 64
+
+typedef struct scf_chain_chunk {
+    struct scf_chain_chunk *next;
+    size_t size;
+    unsigned char data[1];
+} scf_chain_chunk;
+
+static const size_t CHUNK_HEADER_SIZE = offsetof(scf_chain_chunk, data);
+
+static scf_chain_chunk *add_chunk(scf_chain *chain) {
+    scf_chain_chunk *chunk = scf_require_allocation(scf_alloc(chain->operation, CHUNK_HEADER_SIZE + chain->chunk_capacity));
+    chunk->next = NULL;
+    chunk->size = 0;
+    if (chain->last) {
+        chain->last->next = chunk;
+    } else {
+        chain->first = chunk;
+    }
+    
+    chain->last = chunk;
+    return chunk;
+}
+
+scf_chain scf_chain_create(scf_operation *operation, size_t chunk_size) {
+    if (chunk_size == 0) chunk_size = SCF_CHAIN_DEFAULT_CHUNK_SIZE;
+    if (chunk_size <= CHUNK_HEADER_SIZE) scf_raise_error(SCF_LOGIC_ERROR, "Chain chunk size is too small");
+    
+    scf_chain result = {operation, NULL, NULL, 0, chunk_size - CHUNK_HEADER_SIZE};
+    return result;
+}
+
+void scf_chain_append_bytes(scf_chain *chain, const void *bytes_to_append, size_t byte_count) {
+    const unsigned char *source = bytes_to_append;
+    chain->size += byte_count;
+    while (byte_count > 0) {
+        scf_chain_chunk *chunk = chain->last;
+        if (!chunk || chunk->size == chain->chunk_capacity) {
+            chunk = add_chunk(chain);
+        }
+        
+        size_t available = chain->chunk_capacity - chunk->size;
+        size_t count = byte_count < available ? byte_count : available;
+        memcpy(chunk->data + chunk->size, source, count);
+        chunk->size += count;
+        source += count;
+        byte_count -= count;
+    }
+}
+
+void scf_chain_truncate(scf_chain *chain, size_t size) {
+    if (size > chain->size) scf_raise_error(SCF_BAD_INDEX, "Attempting to truncate beyond the end of a chain");
+    if (size == chain->size) return;
+    
+    chain->size = size;
+    scf_chain_chunk *keep = NULL;
+    scf_chain_chunk *chunk = chain->first;
+    while (chunk && size > 0) {
+        if (size <= chunk->size) {
+            chunk->size = size;
+        }
+        
+        size -= chunk->size;
+        keep = chunk;
+        chunk = chunk->next;
+    }
+    
+    while (chunk) {
+        scf_chain_chunk *next = chunk->next;
+        scf_free(chunk);
+        chunk = next;
+    }
+    
+    chain->last = keep;
+    if (keep) {
+        keep->next = NULL;
+    } else {
+        chain->first = NULL;
+    }
+}
+
+scf_buffer scf_chain_flatten(const scf_chain *chain) {
+    scf_buffer result = scf_buffer_create(chain->operation, chain->size);
+    for (scf_chain_chunk *chunk = chain->first; chunk; chunk = chunk->next) {
+        scf_buffer_append_bytes(&result, chunk->data, chunk->size);
+    }
+    
+    return result;
+}
+
+scf_chain_iterator scf_chain_get_iterator(const scf_chain *chain) {
+    scf_chain_iterator result = {chain->first, 0};
+    return result;
+}
+
+bool scf_chain_next(scf_chain_iterator *iter, scf_buffer_view *segment) {
+    if (!iter->chunk) return false;
+    
+    *segment = scf_buffer_view_wrap(iter->chunk->data + iter->offset, iter->chunk->size - iter->offset);
+    iter->chunk = iter->chunk->next;
+    iter->offset = 0;
+    return true;
+}
+
+size_t scf_chain_fill_iovecs(const scf_chain_iterator *iter, scf_iovec *iovecs, size_t max_count) {
+    size_t count = 0;
+    size_t offset = iter->offset;
+    for (const scf_chain_chunk *chunk = iter->chunk; chunk && count < max_count; chunk = chunk->next) {
+        iovecs[count].iov_base = (void *)(chunk->data + offset);
+        iovecs[count].iov_len = chunk->size - offset;
+        count++;
+        offset = 0;
+    }
+    
+    return count;
+}
+
+void scf_chain_advance(scf_chain_iterator *iter, size_t byte_count) {
+    while (iter->chunk && byte_count >= iter->chunk->size - iter->offset) {
+        byte_count -= iter->chunk->size - iter->offset;
+        iter->chunk = iter->chunk->next;
+        iter->offset = 0;
+    }
+    
+    if (iter->chunk) {
+        iter->offset += byte_count;
+    } else if (byte_count > 0) {
+        scf_raise_error(SCF_BAD_INDEX, "Attempting to advance beyond the end of a chain");
+    }
+}
+
+#ifndef WIN32
+void scf_chain_write(const scf_chain *chain, int fd) {
+    scf_iovec iovecs[WRITE_IOV_COUNT];
+    scf_chain_iterator iter = scf_chain_get_iterator(chain);
+    size_t count;
+    while ((count = scf_chain_fill_iovecs(&iter, iovecs, WRITE_IOV_COUNT)) > 0) {
+        ssize_t written = writev(fd, iovecs, (int)count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            scf_raise_os_error(errno, "Failed to write chain");
+        }
+        
+        scf_chain_advance(&iter, (size_t)written);
+    }
+}
+#endif
+
+/*----------------------------------------------
+ * extern declarations for inline functions
+ ---------------------------------------------*/
+
+extern void scf_chain_append_view(scf_chain *chain, scf_buffer_view view);
+
+extern void scf_chain_append_buffer(scf_chain *chain, const scf_buffer *buffer);
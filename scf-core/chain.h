@@ -0,0 +1,112 @@
+//
+//  chain.h
+//  scafell
+//
+
+#ifndef chain_h
+#define chain_h
+
+#include <stdlib.h>
+#include "mmgt.h"
+
+#ifdef WIN32
+typedef struct {
+    void *iov_base;
+    size_t iov_len;
+} scf_iovec;
+#else
+#include <sys/uio.h>
+typedef struct iovec scf_iovec;
+#endif
+
+/*-------------------------------------------------------------------
+ * The default size of the chunks in a chain, including the chunk
+ * header.
+ ------------------------------------------------------------------*/
+#define SCF_CHAIN_DEFAULT_CHUNK_SIZE (64 * 1024)
+
+struct scf_chain_chunk;
+
+/*-------------------------------------------------------------------
+ * A byte sequence held as a list of fixed-size chunks allocated from
+ * an operation. Appending never moves bytes already in the chain, so
+ * building a large output costs one copy of each byte rather than
+ * the repeated copying of a doubling scf_buffer, and no single large
+ * allocation is needed.
+ *
+ * The contents can be walked chunk by chunk as views or iovecs (for
+ * writev-style output), or flattened into a buffer on demand.
+ ------------------------------------------------------------------*/
+typedef struct {
+    scf_operation *operation;
+    struct scf_chain_chunk *first;
+    struct scf_chain_chunk *last;
+    size_t size;
+    size_t chunk_capacity;
+} scf_chain;
+
+/*-------------------------------------------------------------------
+ * A position within a chain, for reading its contents a segment at a
+ * time.
+ ------------------------------------------------------------------*/
+typedef struct {
+    const struct scf_chain_chunk *chunk;
+    size_t offset;
+} scf_chain_iterator;
+
+/*-------------------------------------------------------------------
+ * Creates an empty chain. A chunk_size of 0 selects
+ * SCF_CHAIN_DEFAULT_CHUNK_SIZE.
+ ------------------------------------------------------------------*/
+scf_chain scf_chain_create(scf_operation *operation, size_t chunk_size);
+
+void scf_chain_append_bytes(scf_chain *chain, const void *bytes_to_append, size_t byte_count);
+
+/*-------------------------------------------------------------------
+ * Discards everything after the first 'size' bytes of the chain.
+ ------------------------------------------------------------------*/
+void scf_chain_truncate(scf_chain *chain, size_t size);
+
+/*-------------------------------------------------------------------
+ * Copies the contents of the chain into a new buffer in the chain's
+ * operation.
+ ------------------------------------------------------------------*/
+scf_buffer scf_chain_flatten(const scf_chain *chain);
+
+scf_chain_iterator scf_chain_get_iterator(const scf_chain *chain);
+
+/*-------------------------------------------------------------------
+ * Gets the next contiguous segment of the chain, returning false at
+ * the end. The segment remains valid until the chain is truncated or
+ * its operation completes.
+ ------------------------------------------------------------------*/
+bool scf_chain_next(scf_chain_iterator *iter, scf_buffer_view *segment);
+
+/*-------------------------------------------------------------------
+ * Describes up to 'max_count' segments from the iterator's position
+ * onwards as iovecs, returning the number filled in. The iterator is
+ * not moved: once the bytes have been consumed (for example by a
+ * possibly partial writev), call scf_chain_advance with the number of
+ * bytes actually used.
+ ------------------------------------------------------------------*/
+size_t scf_chain_fill_iovecs(const scf_chain_iterator *iter, scf_iovec *iovecs, size_t max_count);
+
+void scf_chain_advance(scf_chain_iterator *iter, size_t byte_count);
+
+#ifndef WIN32
+/*-------------------------------------------------------------------
+ * Writes the whole chain to a file descriptor with writev, raising
+ * an OS error if a write fails.
+ ------------------------------------------------------------------*/
+void scf_chain_write(const scf_chain *chain, int fd);
+#endif
+
+inline void scf_chain_append_view(scf_chain *chain, scf_buffer_view view) {
+    scf_chain_append_bytes(chain, view.data, view.size);
+}
+
+inline void scf_chain_append_buffer(scf_chain *chain, const scf_buffer *buffer) {
+    scf_chain_append_bytes(chain, scf_buffer_data(buffer), buffer->size);
+}
+
+#endif /* chain_h */
@@ -21,6 +21,7 @@ typedef enum {
     ,SCF_OS_ERROR
     ,SCF_BAD_INDEX
     ,SCF_INVALID_ENCODING
+    ,SCF_BUDGET_EXCEEDED
 } scf_error_code;
 
 typedef struct scf_err_info {
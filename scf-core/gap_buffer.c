@@ -0,0 +1,112 @@
+//
+//  gap_buffer.c
+//  scafell
+//
+
+#include <string.h>
+#include "gap_buffer.h"
+#include "err_handling.h"
+
+static const size_t MIN_CAPACITY = 64;
+
+static inline size_t after_gap_size(const scf_gap_buffer *gap_buffer) {
+    return gap_buffer->capacity - gap_buffer->gap_end;
+}
+
+/*
+ * Grows the gap to at least 'required' bytes. The contents after the
+ * gap move to the end of the enlarged allocation.
+ */
+static void ensure_gap(scf_gap_buffer *gap_buffer, size_t required) {
+    size_t gap_size = gap_buffer->gap_end - gap_buffer->gap_start;
+    if (gap_size >= required) return;
+    
+    size_t size = scf_gap_buffer_size(gap_buffer);
+    size_t new_capacity = 2 * gap_buffer->capacity;
+    if (new_capacity < size + required) new_capacity = size + required;
+    
+    size_t after = after_gap_size(gap_buffer);
+    gap_buffer->data = scf_require_allocation(scf_realloc(gap_buffer->data, new_capacity));
+    memmove(gap_buffer->data + new_capacity - after, gap_buffer->data + gap_buffer->gap_end, after);
+    gap_buffer->gap_end = new_capacity - after;
+    gap_buffer->capacity = new_capacity;
+}
+
+scf_gap_buffer scf_gap_buffer_create(scf_operation *operation, size_t initial_capacity) {
+    if (initial_capacity < MIN_CAPACITY) initial_capacity = MIN_CAPACITY;
+    unsigned char *data = scf_require_allocation(scf_alloc(operation, initial_capacity));
+    scf_gap_buffer result = {0, initial_capacity, initial_capacity, data, operation};
+    return result;
+}
+
+scf_gap_buffer scf_gap_buffer_from_view(scf_operation *operation, scf_buffer_view view) {
+    scf_gap_buffer result = scf_gap_buffer_create(operation, view.size + view.size / 2);
+    scf_gap_buffer_insert_bytes(&result, view.data, view.size);
+    return result;
+}
+
+scf_buffer scf_gap_buffer_to_buffer(const scf_gap_buffer *gap_buffer, scf_operation *operation) {
+    scf_buffer result = scf_buffer_create(operation, scf_gap_buffer_size(gap_buffer));
+    scf_buffer_append_bytes(&result, gap_buffer->data, gap_buffer->gap_start);
+    scf_buffer_append_bytes(&result, gap_buffer->data + gap_buffer->gap_end, after_gap_size(gap_buffer));
+    return result;
+}
+
+void scf_gap_buffer_move_to(scf_gap_buffer *gap_buffer, size_t position) {
+    if (position > scf_gap_buffer_size(gap_buffer)) scf_raise_error(SCF_BAD_INDEX, "Invalid index");
+    
+    if (position < gap_buffer->gap_start) {
+        size_t count = gap_buffer->gap_start - position;
+        memmove(gap_buffer->data + gap_buffer->gap_end - count, gap_buffer->data + position, count);
+        gap_buffer->gap_start -= count;
+        gap_buffer->gap_end -= count;
+    } else if (position > gap_buffer->gap_start) {
+        size_t count = position - gap_buffer->gap_start;
+        memmove(gap_buffer->data + gap_buffer->gap_start, gap_buffer->data + gap_buffer->gap_end, count);
+        gap_buffer->gap_start += count;
+        gap_buffer->gap_end += count;
+    }
+}
+
+void scf_gap_buffer_insert_bytes(scf_gap_buffer *gap_buffer, const void *bytes_to_insert, size_t byte_count) {
+    if (byte_count == 0) return;
+    
+    ensure_gap(gap_buffer, byte_count);
+    memcpy(gap_buffer->data + gap_buffer->gap_start, bytes_to_insert, byte_count);
+    gap_buffer->gap_start += byte_count;
+}
+
+void scf_gap_buffer_delete(scf_gap_buffer *gap_buffer, size_t byte_count) {
+    if (byte_count > after_gap_size(gap_buffer)) scf_raise_error(SCF_BAD_INDEX, "Attempting to remove more data than is present!");
+    
+    gap_buffer->gap_end += byte_count;
+}
+
+void scf_gap_buffer_backspace(scf_gap_buffer *gap_buffer, size_t byte_count) {
+    if (byte_count > gap_buffer->gap_start) scf_raise_error(SCF_BAD_INDEX, "Attempting to remove more data than is present!");
+    
+    gap_buffer->gap_start -= byte_count;
+}
+
+unsigned char scf_gap_buffer_get(const scf_gap_buffer *gap_buffer, size_t index) {
+    if (index >= scf_gap_buffer_size(gap_buffer)) scf_raise_error(SCF_BAD_INDEX, "Invalid index");
+    
+    if (index < gap_buffer->gap_start) {
+        return gap_buffer->data[index];
+    }
+    
+    return gap_buffer->data[index + gap_buffer->gap_end - gap_buffer->gap_start];
+}
+
+void scf_gap_buffer_get_views(const scf_gap_buffer *gap_buffer, scf_buffer_view *before, scf_buffer_view *after) {
+    *before = scf_buffer_view_wrap(gap_buffer->data, gap_buffer->gap_start);
+    *after = scf_buffer_view_wrap(gap_buffer->data + gap_buffer->gap_end, after_gap_size(gap_buffer));
+}
+
+/*----------------------------------------------
+ * extern declarations for inline functions
+ ---------------------------------------------*/
+
+extern size_t scf_gap_buffer_size(const scf_gap_buffer *gap_buffer);
+
+extern size_t scf_gap_buffer_cursor(const scf_gap_buffer *gap_buffer);
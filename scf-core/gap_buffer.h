@@ -0,0 +1,80 @@
+//
+//  gap_buffer.h
+//  scafell
+//
+
+#ifndef gap_buffer_h
+#define gap_buffer_h
+
+#include <stdlib.h>
+#include "mmgt.h"
+
+/*-------------------------------------------------------------------
+ * A byte sequence for editing. The unused capacity is kept as a gap
+ * at the cursor, so inserting or deleting at the cursor costs only
+ * the bytes inserted, and moving the cursor costs only the bytes it
+ * moves over. This suits many localised edits to a large buffer,
+ * where scf_buffer_insert_bytes and scf_buffer_remove would each move
+ * the whole tail of the buffer.
+ *
+ * The contents are data[0, gap_start) followed by
+ * data[gap_end, capacity). The cursor is at gap_start.
+ ------------------------------------------------------------------*/
+typedef struct {
+    size_t gap_start;
+    size_t gap_end;
+    size_t capacity;
+    unsigned char *data;
+    scf_operation *operation;
+} scf_gap_buffer;
+
+scf_gap_buffer scf_gap_buffer_create(scf_operation *operation, size_t initial_capacity);
+
+/*-------------------------------------------------------------------
+ * Creates a gap buffer holding a copy of the given bytes, with the
+ * cursor at the end.
+ ------------------------------------------------------------------*/
+scf_gap_buffer scf_gap_buffer_from_view(scf_operation *operation, scf_buffer_view view);
+
+/*-------------------------------------------------------------------
+ * Copies the contents into a new buffer in the given operation.
+ ------------------------------------------------------------------*/
+scf_buffer scf_gap_buffer_to_buffer(const scf_gap_buffer *gap_buffer, scf_operation *operation);
+
+/*-------------------------------------------------------------------
+ * Moves the cursor to a byte position in the contents.
+ ------------------------------------------------------------------*/
+void scf_gap_buffer_move_to(scf_gap_buffer *gap_buffer, size_t position);
+
+/*-------------------------------------------------------------------
+ * Inserts bytes at the cursor, leaving the cursor after them.
+ ------------------------------------------------------------------*/
+void scf_gap_buffer_insert_bytes(scf_gap_buffer *gap_buffer, const void *bytes_to_insert, size_t byte_count);
+
+/*-------------------------------------------------------------------
+ * Removes the bytes immediately after the cursor.
+ ------------------------------------------------------------------*/
+void scf_gap_buffer_delete(scf_gap_buffer *gap_buffer, size_t byte_count);
+
+/*-------------------------------------------------------------------
+ * Removes the bytes immediately before the cursor.
+ ------------------------------------------------------------------*/
+void scf_gap_buffer_backspace(scf_gap_buffer *gap_buffer, size_t byte_count);
+
+unsigned char scf_gap_buffer_get(const scf_gap_buffer *gap_buffer, size_t index);
+
+/*-------------------------------------------------------------------
+ * Gets views of the contents before and after the cursor. They are
+ * invalidated by any change to the gap buffer.
+ ------------------------------------------------------------------*/
+void scf_gap_buffer_get_views(const scf_gap_buffer *gap_buffer, scf_buffer_view *before, scf_buffer_view *after);
+
+inline size_t scf_gap_buffer_size(const scf_gap_buffer *gap_buffer) {
+    return gap_buffer->capacity - (gap_buffer->gap_end - gap_buffer->gap_start);
+}
+
+inline size_t scf_gap_buffer_cursor(const scf_gap_buffer *gap_buffer) {
+    return gap_buffer->gap_start;
+}
+
+#endif /* gap_buffer_h */
@@ -6,10 +6,17 @@
 //
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include "hash.h"
 #include "mmgt.h"
 #include "list.h"
+#include "hash_mix.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCF_USE_SSE2 1
+#endif
 
 //#ifdef FALSE
 
@@ -17,103 +24,489 @@
 
 static const double MIN_FREE_PERCENTAGE = 25;
 
-static size_t hash(scf_dictionary *d, scf_datum key) {
-    size_t h = d->hash_func(key);
-    return h & (d->capacity - 1);
+static const char PROFILE_TAG[] = "scf_dictionary";
+
+#define GROUP_SIZE 16
+#define CONTROL_EMPTY 0x80
+#define CONTROL_DELETED 0xFE
+
+/*
+ * The number of old table slots migrated by each add or remove while
+ * resizing incrementally.
+ */
+#define MIGRATION_SLOTS 32
+
+/*
+ * The number of new table slots whose metadata is cleared in place of
+ * each old table slot's migration, before migration starts. Clearing a
+ * slot costs far less than migrating one, and this keeps the clearing
+ * short: with an old table of n slots it takes n / 64 adds, which the
+ * old table (a quarter free when the resize began) absorbs meanwhile.
+ */
+#define CLEAR_SLOTS_PER_STEP 4
+
+/*
+ * The items, their stored hashes (if any) and their per-slot metadata
+ * (probe lengths or control bytes, depending on the layout) share one
+ * allocation, in that order.
+ */
+static size_t storage_size(const scf_dictionary *d, size_t capacity) {
+    size_t metadata_size = d->layout == SCF_DICTIONARY_SWISS ? sizeof(unsigned char) : sizeof(uint32_t);
+    size_t hash_size = d->store_hashes ? sizeof(size_t) : 0;
+    return (ITEM_SIZE + hash_size + metadata_size) * capacity;
 }
 
-typedef enum {
-    MATCH, NO_MATCH, TRY_AGAIN
-} match_status;
+/*
+ * Marks 'count' slots from 'start' as empty. Only the metadata needs
+ * initialising: items and hashes are never read from slots the
+ * metadata marks as empty.
+ */
+static void clear_metadata(scf_dictionary *d, size_t start, size_t count) {
+    if (d->layout == SCF_DICTIONARY_SWISS) {
+        memset(d->control + start, CONTROL_EMPTY, count);
+    } else {
+        memset(d->probe_lengths + start, 0, sizeof(uint32_t) * count);
+    }
+}
 
-static match_status is_match(scf_dictionary *d, scf_datum key, bool inserting, size_t index, int collisions) {
-    scf_dictionary_item item = d->items[index];
-    bool found = d->comparison_func(item.key, key);
-    if (inserting) {
-        found = found || item.key.type == DT_NONE;
-        if (found && collisions > d->max_collisions) d->max_collisions = collisions;
+/*
+ * Lays out the storage, but leaves its metadata uninitialised unless
+ * 'clear' is set.
+ */
+static void set_storage(scf_dictionary *d, void *storage, size_t capacity, bool clear) {
+    d->items = storage;
+    d->capacity = capacity;
+    d->max_collisions = 0;
+    d->tombstones = 0;
+    d->hashes = d->store_hashes ? (size_t *)(d->items + capacity) : NULL;
+    void *metadata = d->store_hashes ? (void *)(d->hashes + capacity) : (void *)(d->items + capacity);
+    if (d->layout == SCF_DICTIONARY_SWISS) {
+        d->probe_lengths = NULL;
+        d->control = metadata;
     } else {
-        if (!found && collisions > d->max_collisions) {
-            return NO_MATCH;
-        }
+        d->probe_lengths = metadata;
+        d->control = NULL;
+    }
+    
+    d->cleared = 0;
+    if (clear) {
+        clear_metadata(d, 0, capacity);
+        d->cleared = capacity;
     }
+}
+
+/*
+ * With stored hashes, comparison_func is only called for keys whose
+ * full hashes are equal.
+ */
+static inline bool matches(const scf_dictionary *d, size_t index, scf_datum key, size_t h) {
+    if (d->hashes && d->hashes[index] != h) return false;
     
-    return found ? MATCH : TRY_AGAIN;
+    return d->comparison_func(d->items[index].key, key);
+}
+
+/*
+ * Robin Hood hashing with linear probing. Each slot records 1 + the
+ * distance of its item from the item's home slot, or 0 if the slot is
+ * empty. Insertion displaces any item closer to its home than the one
+ * being inserted, so along a probe sequence the recorded lengths never
+ * drop by more than one. A lookup can therefore stop as soon as it
+ * meets a slot whose length is less than its own, and only needs to
+ * compare keys in slots whose length equals its own, since any other
+ * item there has a different home slot.
+ */
+static size_t robin_hood_find(const scf_dictionary *d, scf_datum key, size_t h) {
+    size_t mask = d->capacity - 1;
+    size_t index = h & mask;
+    for (uint32_t probe_length = 1;; probe_length++) {
+        uint32_t resident_length = d->probe_lengths[index];
+        if (resident_length < probe_length) return -1;
+        
+        if (resident_length == probe_length && matches(d, index, key, h)) return index;
+        
+        index = (index + 1) & mask;
+    }
+}
+
+static void robin_hood_insert(scf_dictionary *d, scf_dictionary_item item, size_t h) {
+    size_t mask = d->capacity - 1;
+    size_t index = h & mask;
+    for (uint32_t probe_length = 1;; probe_length++) {
+        uint32_t resident_length = d->probe_lengths[index];
+        if (resident_length < probe_length) {
+            if ((int)probe_length - 1 > d->max_collisions) d->max_collisions = (int)probe_length - 1;
+            
+            scf_dictionary_item displaced = d->items[index];
+            d->items[index] = item;
+            d->probe_lengths[index] = probe_length;
+            if (d->hashes) {
+                size_t displaced_hash = d->hashes[index];
+                d->hashes[index] = h;
+                h = displaced_hash;
+            }
+            
+            if (resident_length == 0) return;
+            
+            item = displaced;
+            probe_length = resident_length;
+        }
+        
+        index = (index + 1) & mask;
+    }
 }
 
-static size_t next_inc(scf_dictionary *d, int collision_count) {
+/*
+ * Removes the item at 'index', shifting the following items back a
+ * slot until one is found that is empty or already in its home slot,
+ * rather than leaving a tombstone.
+ */
+static void robin_hood_remove(scf_dictionary *d, size_t index) {
     size_t mask = d->capacity - 1;
-    size_t factor = mask >> 1;
-    size_t n = (collision_count * factor) & mask;
-    size_t a = n;
-    size_t b = n + 1;
-    if ((a & 1) == 0) {
-        a = (a >> 1) & mask;
-        b &= mask;
+    size_t next = (index + 1) & mask;
+    while (d->probe_lengths[next] > 1) {
+        d->items[index] = d->items[next];
+        d->probe_lengths[index] = d->probe_lengths[next] - 1;
+        if (d->hashes) d->hashes[index] = d->hashes[next];
+        index = next;
+        next = (next + 1) & mask;
+    }
+    
+    d->items[index].key = dt_none();
+    d->items[index].value = dt_none();
+    d->probe_lengths[index] = 0;
+}
+
+/*
+ * Swiss table layout. The slots are divided into groups of GROUP_SIZE,
+ * and each slot has a control byte: CONTROL_EMPTY, CONTROL_DELETED, or
+ * for a full slot the low 7 bits of its key's hash (the "tag"). The
+ * remaining bits of the hash select the first group to probe, and
+ * later groups are probed in triangular order, which visits every
+ * group since the number of groups is a power of 2.
+ *
+ * The tag and group are taken from the hash after mixing it with
+ * scf_hash_uint64. Otherwise a weak hash function, such as the
+ * identity on integers, gives runs of keys the same group and no two
+ * of them the same tag, and every probe walks the run.
+ *
+ * A probe compares a whole group's control bytes against the tag at
+ * once, and only calls comparison_func on slots whose tags match, so
+ * most misses never touch the items at all. A probe ends at a group
+ * with an empty slot.
+ */
+static inline unsigned char tag_of(size_t mixed) {
+    return mixed & 0x7F;
+}
+
+static inline size_t group_of(const scf_dictionary *d, size_t mixed) {
+    return (mixed >> 7) & (d->capacity / GROUP_SIZE - 1);
+}
+
+#ifdef SCF_USE_SSE2
+static inline unsigned match_byte(const unsigned char *group, unsigned char byte) {
+    __m128i control = _mm_loadu_si128((const __m128i *)group);
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8((char)byte)));
+}
+
+/*
+ * Both CONTROL_EMPTY and CONTROL_DELETED have the top bit set, and
+ * tags don't, so the available slots are just the sign bits.
+ */
+static inline unsigned match_available(const unsigned char *group) {
+    return (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+}
+#else
+static inline unsigned match_byte(const unsigned char *group, unsigned char byte) {
+    unsigned result = 0;
+    for (int i = 0; i < GROUP_SIZE; i++) {
+        if (group[i] == byte) result |= 1u << i;
+    }
+    
+    return result;
+}
+
+static inline unsigned match_available(const unsigned char *group) {
+    unsigned result = 0;
+    for (int i = 0; i < GROUP_SIZE; i++) {
+        if (group[i] & 0x80) result |= 1u << i;
+    }
+    
+    return result;
+}
+#endif
+
+static inline int lowest_bit(unsigned mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(mask);
+#else
+    int result = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        result++;
+    }
+    
+    return result;
+#endif
+}
+
+static size_t swiss_find(const scf_dictionary *d, scf_datum key, size_t h) {
+    size_t mixed = scf_hash_uint64(h);
+    unsigned char tag = tag_of(mixed);
+    size_t group_mask = d->capacity / GROUP_SIZE - 1;
+    size_t group = group_of(d, mixed);
+    for (size_t probes = 1;; probes++) {
+        const unsigned char *control = d->control + group * GROUP_SIZE;
+        for (unsigned candidates = match_byte(control, tag); candidates; candidates &= candidates - 1) {
+            size_t index = group * GROUP_SIZE + lowest_bit(candidates);
+            if (matches(d, index, key, h)) return index;
+        }
+        
+        if (match_byte(control, CONTROL_EMPTY)) return -1;
+        
+        group = (group + probes) & group_mask;
+    }
+}
+
+static void swiss_insert(scf_dictionary *d, scf_dictionary_item item, size_t h) {
+    size_t mixed = scf_hash_uint64(h);
+    size_t group_mask = d->capacity / GROUP_SIZE - 1;
+    size_t group = group_of(d, mixed);
+    for (int probes = 1;; probes++) {
+        unsigned available = match_available(d->control + group * GROUP_SIZE);
+        if (available) {
+            size_t index = group * GROUP_SIZE + lowest_bit(available);
+            if (d->control[index] == CONTROL_DELETED) d->tombstones--;
+            
+            d->control[index] = tag_of(mixed);
+            d->items[index] = item;
+            if (d->hashes) d->hashes[index] = h;
+            if (probes - 1 > d->max_collisions) d->max_collisions = probes - 1;
+            return;
+        }
+        
+        group = (group + probes) & group_mask;
+    }
+}
+
+/*
+ * A slot can only be marked empty if its group already has an empty
+ * slot: otherwise a probe may have passed through the group on its
+ * way to a later one, and an empty slot here would end it too soon.
+ */
+static void swiss_remove(scf_dictionary *d, size_t index) {
+    const unsigned char *group = d->control + index / GROUP_SIZE * GROUP_SIZE;
+    if (match_byte(group, CONTROL_EMPTY)) {
+        d->control[index] = CONTROL_EMPTY;
     } else {
-        a &= mask;
-        b = (b >> 1) & mask;
+        d->control[index] = CONTROL_DELETED;
+        d->tombstones++;
     }
     
-    return (a * b) & mask;
+    d->items[index].key = dt_none();
+    d->items[index].value = dt_none();
 }
 
-static size_t lookup(scf_dictionary *d, scf_datum key, bool inserting) {
-    size_t original_index = hash(d, key);
+static size_t find(const scf_dictionary *d, scf_datum key, size_t h) {
+    if (d->layout == SCF_DICTIONARY_SWISS) return swiss_find(d, key, h);
     
-    int collisions = 0;
-    size_t current_index = original_index;
-    for (;;) {
-        size_t inc;
-        switch (is_match(d, key, inserting, current_index, collisions)) {
-            case MATCH:
-                return current_index;
-            case NO_MATCH:
-                return -1;
-            case TRY_AGAIN:
-                collisions++;
-                inc = next_inc(d, collisions);
-                current_index = (original_index + inc) & (d->capacity - 1);
+    return robin_hood_find(d, key, h);
+}
+
+/*
+ * Inserts an item whose key isn't already present, given the key's
+ * hash.
+ */
+static void insert_new(scf_dictionary *d, scf_dictionary_item item, size_t h) {
+    if (d->layout == SCF_DICTIONARY_SWISS) {
+        swiss_insert(d, item, h);
+    } else {
+        robin_hood_insert(d, item, h);
+    }
+}
+
+static void remove_at(scf_dictionary *d, size_t index) {
+    if (d->layout == SCF_DICTIONARY_SWISS) {
+        swiss_remove(d, index);
+    } else {
+        robin_hood_remove(d, index);
+    }
+}
+
+static bool is_occupied(const scf_dictionary *d, size_t index) {
+    if (d->layout == SCF_DICTIONARY_SWISS) return !(d->control[index] & 0x80);
+    
+    return d->probe_lengths[index] != 0;
+}
+
+/*
+ * Incremental resizing. Rather than moving every item at once, the
+ * dictionary moves to new storage and keeps its previous table as
+ * old_table, and each add or remove then migrates up to
+ * MIGRATION_SLOTS of the old table's slots. Lookups consult the new
+ * table and then the old one. Since the new table has twice the
+ * capacity, migration always finishes long before it fills.
+ *
+ * The new table's metadata is cleared in the same steps before
+ * migration starts. Until it has all been cleared the new table is
+ * empty and can't be probed, so the dictionary works on the old table
+ * alone and adds go there.
+ *
+ * Migrated items are copied, not removed, so that the old table's
+ * probe sequences stay intact, and anything found in the migrated
+ * slots is ignored. Migration starts at a slot that no Robin Hood
+ * chain runs through (an empty slot or an item in its home slot), so
+ * a backward shift when removing from the unmigrated slots can never
+ * reach the migrated ones.
+ */
+static bool is_migrated(const scf_dictionary *d, size_t index) {
+    return ((index - d->migration_start) & (d->old_table->capacity - 1)) < d->migrated;
+}
+
+static inline bool is_clearing(const scf_dictionary *d) {
+    return d->cleared < d->capacity;
+}
+
+/*
+ * Finds a key in the dictionary's own table, which is empty while its
+ * metadata is being cleared.
+ */
+static size_t find_in_table(const scf_dictionary *d, scf_datum key, size_t h) {
+    if (is_clearing(d)) return -1;
+    
+    return find(d, key, h);
+}
+
+static size_t find_in_old_table(const scf_dictionary *d, scf_datum key, size_t h) {
+    if (!d->old_table) return -1;
+    
+    size_t index = find(d->old_table, key, h);
+    if (index == -1 || is_migrated(d, index)) return -1;
+    
+    return index;
+}
+
+static size_t find_migration_start(const scf_dictionary *old_table) {
+    if (old_table->layout == SCF_DICTIONARY_SWISS) return 0;
+    
+    size_t index = 0;
+    while (old_table->probe_lengths[index] > 1) {
+        index++;
+    }
+    
+    return index;
+}
+
+/*
+ * Advances an incremental resize by up to 'slot_count' old table slots'
+ * worth of work: clearing the new table's metadata, and then migrating.
+ */
+static void migrate(scf_dictionary *d, size_t slot_count) {
+    scf_dictionary *old_table = d->old_table;
+    if (is_clearing(d)) {
+        size_t remaining = d->capacity - d->cleared;
+        size_t count = slot_count < remaining / CLEAR_SLOTS_PER_STEP ? slot_count * CLEAR_SLOTS_PER_STEP : remaining;
+        clear_metadata(d, d->cleared, count);
+        d->cleared += count;
+        if (is_clearing(d)) return;
+        
+        d->migration_start = find_migration_start(old_table);
+    }
+    
+    size_t mask = old_table->capacity - 1;
+    for (; slot_count > 0 && d->migrated < old_table->capacity; slot_count--) {
+        size_t index = (d->migration_start + d->migrated) & mask;
+        if (is_occupied(old_table, index)) {
+            scf_dictionary_item item = old_table->items[index];
+            insert_new(d, item, old_table->hashes ? old_table->hashes[index] : d->hash_func(item.key));
         }
+        
+        d->migrated++;
+    }
+    
+    if (d->migrated == old_table->capacity) {
+        scf_free(old_table->items);
+        scf_free(old_table);
+        d->old_table = NULL;
     }
 }
 
+static void start_migration(scf_dictionary *d, size_t capacity) {
+    scf_operation *operation = scf_get_operation(d->items);
+    scf_profile_push_tag(PROFILE_TAG);
+    scf_dictionary *old_table = scf_require_allocation(scf_alloc(operation, sizeof(scf_dictionary)));
+    *old_table = *d;
+    set_storage(d, scf_require_allocation(scf_alloc(operation, storage_size(d, capacity))), capacity, false);
+    scf_profile_pop_tag();
+    
+    d->old_table = old_table;
+    d->migration_start = 0;
+    d->migrated = 0;
+}
+
 static scf_dictionary_item *copy_items(scf_operation *operation, const scf_dictionary *d) {
-    scf_dictionary_item *result = scf_alloc(operation, ITEM_SIZE * d->size);
+    scf_dictionary_item *result = scf_require_allocation(scf_alloc(operation, ITEM_SIZE * d->size));
     int j = 0;
-    for (int i = 0; i < d->capacity; i++) {
-        if (d->items[i].key.type != DT_NONE) {
+    for (int i = 0; i < d->capacity && !is_clearing(d); i++) {
+        if (is_occupied(d, i)) {
             result[j++] = d->items[i];
         }
     }
     
+    for (size_t i = 0; d->old_table && i < d->old_table->capacity; i++) {
+        if (!is_migrated(d, i) && is_occupied(d->old_table, i)) {
+            result[j++] = d->old_table->items[i];
+        }
+    }
+    
+    return result;
+}
+
+static size_t *copy_hashes(scf_operation *operation, const scf_dictionary *d) {
+    size_t *result = scf_require_allocation(scf_alloc(operation, sizeof(size_t) * d->size));
+    int j = 0;
+    for (int i = 0; i < d->capacity; i++) {
+        if (is_occupied(d, i)) {
+            result[j++] = d->hashes[i];
+        }
+    }
+    
     return result;
 }
 
 static void rehash(scf_dictionary *d, size_t capacity) {
     SCF_OPERATION(rehashing);
+    scf_profile_push_tag(PROFILE_TAG);
     size_t size = d->size;
     scf_dictionary_item *copy = copy_items(&rehashing, d);
+    size_t *hashes = d->hashes ? copy_hashes(&rehashing, d) : NULL;
     
-    d->items = scf_realloc(d->items, ITEM_SIZE * capacity);
-    memset(d->items, 0, ITEM_SIZE * capacity);
-    d->capacity = capacity;
-    d->max_collisions = 0;
-
+    set_storage(d, scf_require_allocation(scf_realloc(d->items, storage_size(d, capacity))), capacity, true);
     for (int i = 0; i < size; i++) {
-        size_t index = lookup(d, copy[i].key, true);
-        d->items[index].key = copy[i].key;
-        d->items[index].value = copy[i].value;
+        insert_new(d, copy[i], hashes ? hashes[i] : d->hash_func(copy[i].key));
     }
     
     scf_complete(&rehashing);
+    scf_profile_pop_tag();
 }
 
+/*
+ * Tombstones left by removals from a Swiss table count against the
+ * free space, since they lengthen probes just as items do. If they
+ * account for much of it, the table is rebuilt at the same size to
+ * clear them rather than doubled.
+ */
 static void ensure_capacity(scf_dictionary *d) {
-    double new_size = d->size + 1;
+    double new_size = d->size + d->tombstones + 1;
     double percent_free = 100.0 * (d->capacity - new_size) / d->capacity;
     if (percent_free < MIN_FREE_PERCENTAGE) {
-        rehash(d, d->capacity * 2);
+        if (d->old_table) migrate(d, SIZE_MAX);
+        
+        size_t capacity = d->size + 1 < d->capacity / 2 ? d->capacity : d->capacity * 2;
+        if (d->incremental_rehash) {
+            start_migration(d, capacity);
+        } else {
+            rehash(d, capacity);
+        }
     }
 }
 
@@ -136,54 +529,104 @@ scf_dictionary scf_dictionary_create(
                                      scf_hash_func hash_func,
                                      scf_comparison_func comparison_func,
                                      size_t initial_capacity) {
+    scf_dictionary_options options = {SCF_DICTIONARY_ROBIN_HOOD, false, false};
+    return scf_dictionary_create_with_options(operation, hash_func, comparison_func, initial_capacity, options);
+}
+
+scf_dictionary scf_dictionary_create_with_layout(
+                                                 scf_operation *operation,
+                                                 scf_hash_func hash_func,
+                                                 scf_comparison_func comparison_func,
+                                                 size_t initial_capacity,
+                                                 scf_dictionary_layout layout) {
+    scf_dictionary_options options = {layout, false, false};
+    return scf_dictionary_create_with_options(operation, hash_func, comparison_func, initial_capacity, options);
+}
+
+scf_dictionary scf_dictionary_create_with_options(
+                                                  scf_operation *operation,
+                                                  scf_hash_func hash_func,
+                                                  scf_comparison_func comparison_func,
+                                                  size_t initial_capacity,
+                                                  scf_dictionary_options options) {
     if (initial_capacity < MIN_CAPACITY) initial_capacity = MIN_CAPACITY;
     initial_capacity = round_up(initial_capacity);
     scf_dictionary result;
     result.size = 0;
-    result.capacity = initial_capacity;
     result.comparison_func = comparison_func;
     result.hash_func = hash_func;
-    result.max_collisions = 0;
-    result.items = scf_alloc(operation, ITEM_SIZE * initial_capacity);
-    memset(result.items, 0, ITEM_SIZE * initial_capacity);
+    result.layout = options.layout;
+    result.store_hashes = options.store_hashes;
+    result.incremental_rehash = options.incremental_rehash;
+    result.old_table = NULL;
+    result.migration_start = 0;
+    result.migrated = 0;
+    scf_profile_push_tag(PROFILE_TAG);
+    set_storage(&result, scf_require_allocation(scf_alloc(operation, storage_size(&result, initial_capacity))), initial_capacity, true);
+    scf_profile_pop_tag();
     return result;
 }
 
+/*
+ * Finds the item with the given key in either the dictionary's table
+ * or, while resizing incrementally, the unmigrated part of its old
+ * table.
+ */
+static scf_dictionary_item *find_item(const scf_dictionary *d, scf_datum key, size_t h) {
+    size_t index = find_in_table(d, key, h);
+    if (index != -1) return d->items + index;
+    
+    index = find_in_old_table(d, key, h);
+    if (index != -1) return d->old_table->items + index;
+    
+    return NULL;
+}
+
 scf_datum scf_dictionary_add(scf_dictionary *d, scf_datum key, scf_datum value) {
-    ensure_capacity(d);
-    size_t index = lookup(d, key, true);
-    scf_dictionary_item *item = d->items + index;
-    if (item->key.type == DT_NONE) {
-        d->size++;
+    size_t h = d->hash_func(key);
+    scf_dictionary_item *existing = find_item(d, key, h);
+    if (existing) {
+        scf_datum original_value = existing->value;
+        existing->key = key;
+        existing->value = value;
+        return original_value;
     }
     
-    scf_datum original_value = item->value;
-    item->key = key;
-    item->value = value;
-
-    return original_value;
+    ensure_capacity(d);
+    scf_dictionary_item item = {key, value};
+    insert_new(is_clearing(d) ? d->old_table : d, item, h);
+    d->size++;
+    if (d->old_table) migrate(d, MIGRATION_SLOTS);
+    
+    return dt_none();
 }
 
 scf_datum scf_dictionary_remove(scf_dictionary *d, scf_datum key) {
-    size_t index = lookup(d, key, false);
-    if (index == -1) {
+    size_t h = d->hash_func(key);
+    scf_datum original_value;
+    size_t index = find_in_table(d, key, h);
+    if (index != -1) {
+        original_value = d->items[index].value;
+        remove_at(d, index);
+    } else if ((index = find_in_old_table(d, key, h)) != -1) {
+        original_value = d->old_table->items[index].value;
+        remove_at(d->old_table, index);
+    } else {
         return dt_none();
     }
     
-    scf_dictionary_item *item = d->items + index;
-    scf_datum original_value = item->value;
-    item->key = dt_none();
-    item->value = dt_none();
     d->size--;
+    if (d->old_table) migrate(d, MIGRATION_SLOTS);
+    
     return original_value;
 }
 
 scf_datum *scf_dictionary_lookup(const scf_dictionary *d, scf_datum key) {
-    size_t index = lookup((scf_dictionary *)d, key, false);
-    if (index == -1) {
+    scf_dictionary_item *item = find_item(d, key, d->hash_func(key));
+    if (item == NULL) {
         return NULL;
     } else {
-        return &d->items[index].value;
+        return &item->value;
     }
 }
 
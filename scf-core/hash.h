@@ -9,6 +9,7 @@
 #define hash_h
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "datum.h"
 #include "mmgt.h"
@@ -22,13 +23,79 @@ typedef struct {
     scf_datum value;
 } scf_dictionary_item;
 
+/*-------------------------------------------------------------------
+ * The slot layouts a dictionary can use.
+ *
+ * SCF_DICTIONARY_ROBIN_HOOD: Robin Hood open addressing. probe_lengths
+ * holds, for each slot, 1 + the distance of its item from the item's
+ * home slot, or 0 for an empty slot. Removal shifts items back rather
+ * than leaving tombstones, so probe lengths stay short under repeated
+ * insertion and removal.
+ *
+ * SCF_DICTIONARY_SWISS: a Swiss table. control holds a byte per slot
+ * with 7 bits of the key's hash, scanned 16 slots at a time (with
+ * SSE2 where available), so comparison_func is only called when those
+ * bits match. This makes misses much cheaper, particularly with
+ * expensive comparisons, at the cost of tombstones after removal.
+ *
+ * max_collisions is the longest probe made by an insertion since the
+ * table was last resized: in slots for SCF_DICTIONARY_ROBIN_HOOD, and
+ * in groups of 16 slots for SCF_DICTIONARY_SWISS.
+ ------------------------------------------------------------------*/
+typedef enum {
+    SCF_DICTIONARY_ROBIN_HOOD,
+    SCF_DICTIONARY_SWISS
+} scf_dictionary_layout;
+
+/*-------------------------------------------------------------------
+ * Options for scf_dictionary_create_with_options.
+ *
+ * store_hashes: keep each item's full hash in a hashes array parallel
+ * to the items. Resizing then never calls hash_func, and a probe only
+ * calls comparison_func when the full hashes match. Worthwhile for
+ * keys that are expensive to hash or compare, such as strings, at a
+ * cost of sizeof(size_t) per slot.
+ *
+ * incremental_rehash: when the dictionary grows, move its items to the
+ * larger table a few at a time during later adds and removes, rather
+ * than all at once. Even the new table's metadata is initialised a
+ * step at a time, so that no add or remove does work proportional to
+ * the dictionary's size. This bounds the time any one add can take, at
+ * the cost of lookups checking both tables until the move completes
+ * and both being allocated meanwhile.
+ ------------------------------------------------------------------*/
 typedef struct {
+    scf_dictionary_layout layout;
+    bool store_hashes;
+    bool incremental_rehash;
+} scf_dictionary_options;
+
+typedef struct scf_dictionary {
     scf_hash_func hash_func;
     scf_comparison_func comparison_func;
+    scf_dictionary_layout layout;
+    bool store_hashes;
+    bool incremental_rehash;
     size_t size;
     size_t capacity;
+    size_t tombstones;
     int max_collisions;
     scf_dictionary_item *items;
+    size_t *hashes;
+    uint32_t *probe_lengths;
+    unsigned char *control;
+    
+    /*
+     * While resizing incrementally, the previous table, whose slots are
+     * migrated in order starting at migration_start. 'migrated' counts
+     * the slots done so far. Before migration starts, the new table's
+     * metadata is initialised a step at a time; 'cleared' counts the
+     * slots initialised so far.
+     */
+    struct scf_dictionary *old_table;
+    size_t migration_start;
+    size_t migrated;
+    size_t cleared;
 } scf_dictionary;
 
 typedef struct {
@@ -37,6 +104,10 @@ typedef struct {
 
 scf_dictionary scf_dictionary_create(scf_operation *operation, scf_hash_func, scf_comparison_func, size_t initial_capacity);
 
+scf_dictionary scf_dictionary_create_with_layout(scf_operation *operation, scf_hash_func, scf_comparison_func, size_t initial_capacity, scf_dictionary_layout layout);
+
+scf_dictionary scf_dictionary_create_with_options(scf_operation *operation, scf_hash_func, scf_comparison_func, size_t initial_capacity, scf_dictionary_options options);
+
 scf_datum scf_dictionary_add(scf_dictionary *, scf_datum key, scf_datum value);
 
 scf_datum scf_dictionary_remove(scf_dictionary *, scf_datum key);
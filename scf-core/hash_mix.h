@@ -0,0 +1,24 @@
+//
+//  hash_mix.h
+//  scafell
+//
+
+#ifndef hash_mix_h
+#define hash_mix_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*-------------------------------------------------------------------
+ * Mixes the bits of a 64-bit key (with the MurmurHash3 finaliser) so
+ * that every bit of the key affects every bit of the result. Suits
+ * integer or pointer keys, whose low bits are often poorly
+ * distributed.
+ ------------------------------------------------------------------*/
+static inline size_t scf_hash_uint64(uint64_t key) {
+    key = (key ^ (key >> 33)) * 0xFF51AFD7ED558CCDu;
+    key = (key ^ (key >> 33)) * 0xC4CEB9FE1A85EC53u;
+    return (size_t)(key ^ (key >> 33));
+}
+
+#endif /* hash_mix_h */
@@ -9,26 +9,63 @@
 #include "list.h"
 #include "err_handling.h"
 
+/*
+ * The smallest capacity a list grows to, so that a list created empty
+ * doesn't reallocate for each of its first few items.
+ */
+static const size_t MIN_GROWTH_CAPACITY = 4;
+
+/*
+ * The number of bytes needed for a given number of items.
+ */
+static size_t storage_size(size_t capacity) {
+    if (capacity > SIZE_MAX / SCF_DATUM_SIZE) scf_raise_error(SCF_OUT_OF_MEMORY, "Requested capacity is too large");
+    
+    return SCF_DATUM_SIZE * capacity;
+}
+
+static void set_capacity(scf_list *list, size_t new_capacity) {
+    list->items = scf_require_allocation(scf_realloc(list->items, storage_size(new_capacity)));
+    list->capacity = new_capacity;
+}
+
 static void ensure_capacity(scf_list *list, size_t minimum_capacity) {
     if (list->capacity >= minimum_capacity) {
         return;
     }
     
-    size_t new_capacity = 2 * list->capacity;
-    if (new_capacity < minimum_capacity) {
-        new_capacity = minimum_capacity;
+    size_t new_capacity = scf_grown_capacity(list->capacity, list->growth_factor, minimum_capacity, SIZE_MAX / SCF_DATUM_SIZE);
+    if (new_capacity < MIN_GROWTH_CAPACITY) {
+        new_capacity = MIN_GROWTH_CAPACITY;
     }
     
-    list->items = scf_realloc(list->items, SCF_DATUM_SIZE * new_capacity);
-    list->capacity = new_capacity;
+    set_capacity(list, new_capacity);
 }
 
 scf_list scf_list_create(scf_operation *operation, size_t initial_capacity) {
-    scf_datum *items = scf_alloc(operation, SCF_DATUM_SIZE * initial_capacity);
-    scf_list result = {0, initial_capacity, items};
+    scf_datum *items = scf_require_allocation(scf_alloc(operation, storage_size(initial_capacity)));
+    scf_list result = {0, initial_capacity, items, 0};
     return result;
 }
 
+void scf_list_reserve(scf_list *list, size_t capacity) {
+    if (list->capacity < capacity) {
+        set_capacity(list, capacity);
+    }
+}
+
+void scf_list_shrink_to_fit(scf_list *list) {
+    if (list->size < list->capacity) {
+        set_capacity(list, list->size);
+    }
+}
+
+void scf_list_set_growth_factor(scf_list *list, double growth_factor) {
+    if (!(growth_factor > 1.0)) scf_raise_error(SCF_LOGIC_ERROR, "Growth factor must be greater than 1");
+    
+    list->growth_factor = growth_factor;
+}
+
 void scf_list_add(scf_list *list, scf_datum new_item) {
     ensure_capacity(list, list->size + 1);
     list->items[list->size++] = new_item;
@@ -16,10 +16,33 @@ typedef struct {
     size_t size;
     size_t capacity;
     scf_datum *items;
+    
+    /*
+     * The factor applied to the capacity when the list grows, or 0
+     * for SCF_DEFAULT_GROWTH_FACTOR.
+     */
+    double growth_factor;
 } scf_list;
 
 scf_list scf_list_create(scf_operation *operation, size_t initial_capacity);
 
+/*
+ * Ensures the list can hold at least 'capacity' items without further
+ * allocation, growing it to exactly that capacity if needed.
+ */
+void scf_list_reserve(scf_list *list, size_t capacity);
+
+/*
+ * Releases the list's unused capacity.
+ */
+void scf_list_shrink_to_fit(scf_list *list);
+
+/*
+ * Sets the factor by which the list's capacity is multiplied when it
+ * grows. The factor must be greater than 1.
+ */
+void scf_list_set_growth_factor(scf_list *list, double growth_factor);
+
 void scf_list_add(scf_list *list, scf_datum new_item);
 
 void scf_list_append(scf_list *list1, const scf_list *list2);
@@ -5,168 +5,1858 @@
 //  Created by Tony on 16/06/2025.
 //
 
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stddef.h>
 #include <string.h>
 
-#include "mmgt.h"
-#include "err_handling.h"
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#ifdef __linux__
+#define SCF_USE_MMAP 1
+#endif
+
+#include "mmgt.h"
+#include "err_handling.h"
+#include "osdefs.h"
+#include "hash_mix.h"
+
+static const int HEADER_SIZE = offsetof(scf_mem_block, data);
+static const int MIN_CAPACITY = 4;
+
+/*
+ * Arena mode parameters. Requests larger than MAX_SLAB_ALLOCATION are
+ * not worth carving out of a slab and are allocated individually.
+ */
+#define SLAB_SIZE (64 * 1024)
+#define MAX_SLAB_ALLOCATION (SLAB_SIZE / 4)
+#define ALIGNMENT ((size_t)16)
+
+#define BLOCK_IN_SLAB 1
+#define BLOCK_MARKER 2
+#define BLOCK_ALIGNED 4
+#define BLOCK_MAPPED 8
+#define BLOCK_COMPACT 16
+#define BLOCK_REGISTERED 32
+
+/*
+ * For aligned blocks, log2 of the alignment is kept in the flags.
+ */
+#define ALIGNMENT_SHIFT_POS 8
+#define ALIGNMENT_SHIFT_MASK 0xFF
+
+/*
+ * Compact blocks keep their size in the upper bits of their flags.
+ */
+#define COMPACT_SIZE_SHIFT 8
+#define COMPACT_FLAGS_MASK 0xFF
+#define MAX_COMPACT_ALLOCATION 256
+#define COMPACT_ALIGNMENT ((size_t)8)
+
+#define MIN_CLASS_SHIFT 4
+
+#define THREAD_CACHE_ENTRIES 8
+
+/*
+ * How far a thread cache's live bytes may drift before the change is
+ * published to its concurrent operation's shared count.
+ */
+#define SHARED_LIVE_BYTES_BATCH (64 * 1024)
+
+/*
+ * Slabs are numbered in the order they were brought into use, so that
+ * the slab chain is in descending order of sequence.
+ */
+typedef struct scf_slab {
+    struct scf_slab *next;
+    struct scf_operation *operation;
+    size_t used;
+    size_t capacity;
+    size_t sequence;
+} scf_slab;
+
+/*
+ * The header of an allocation in a compact operation. 'offset' locates
+ * the slab (and through it the operation) the allocation lives in. The
+ * flags are laid out to coincide with those of a full block header, so
+ * either kind of header can be recognised from the data pointer.
+ */
+typedef struct {
+    uint32_t offset;
+    uint32_t flags;
+} compact_header;
+
+static const int COMPACT_HEADER_SIZE = sizeof(compact_header);
+
+typedef struct scf_registered_cleanup {
+    void *data;
+    scf_cleanup_func cleanup;
+} scf_registered_cleanup;
+
+/*
+ * The payload of the marker block that scf_operation_mark places in the
+ * block list. It records the slab state immediately before the marker
+ * was allocated, and the marker of the previous outstanding mark.
+ */
+typedef struct {
+    scf_slab *slab;
+    size_t used;
+    size_t cleanup_count;
+    size_t live_bytes;
+    struct scf_mem_block *previous_marker;
+} marker_info;
+
+static void default_exhaustion_handler(void) {
+    fprintf(stderr, "Out of memory!\n");
+    exit(1);
+}
+
+scf_exhaustion_handler exhaustion_handler = default_exhaustion_handler;
+
+size_t scf_mmap_threshold = 4 * 1024 * 1024;
+
+/*
+ * Each thread remembers the caches it has created for the concurrent
+ * operations it has recently used. An entry is only valid while the
+ * operation's id matches, which stops a completed operation (or a new one
+ * at the same address) from picking up a stale cache.
+ */
+typedef struct {
+    scf_operation *operation;
+    uint64_t id;
+    scf_operation *cache;
+} thread_cache_entry;
+
+static SCF_THREAD_LOCAL thread_cache_entry thread_caches[THREAD_CACHE_ENTRIES];
+static SCF_THREAD_LOCAL unsigned next_thread_cache;
+static uint64_t next_operation_id = 1;
+
+/*
+ * Sampling profiler state. Each thread counts down the bytes until its
+ * next sample, and keeps its own stack of tags. Samples are aggregated
+ * by tag stack into a fixed table, so that taking one never allocates.
+ */
+#define PROFILE_MAX_STACKS 1024
+
+typedef struct {
+    const char *tag;
+    unsigned repeats;
+} profile_frame;
+
+typedef struct {
+    int depth;
+    const char *tags[SCF_PROFILE_MAX_DEPTH];
+    size_t samples;
+    size_t bytes;
+} profile_entry;
+
+static uint64_t profile_interval;
+static uint64_t profile_lock;
+static profile_entry profile_entries[PROFILE_MAX_STACKS];
+static size_t profile_overflow_bytes;
+
+static SCF_THREAD_LOCAL profile_frame profile_tags[SCF_PROFILE_MAX_DEPTH];
+static SCF_THREAD_LOCAL int profile_depth;
+static SCF_THREAD_LOCAL size_t bytes_until_sample;
+static SCF_THREAD_LOCAL uint64_t profile_random;
+
+static void *libc_alloc(void *context, size_t size) {
+    (void)context;
+    return malloc(size);
+}
+
+static void *libc_realloc(void *context, void *p, size_t size) {
+    (void)context;
+    return realloc(p, size);
+}
+
+static void libc_free(void *context, void *p) {
+    (void)context;
+    free(p);
+}
+
+const scf_allocator scf_libc_allocator = {libc_alloc, libc_realloc, libc_free, NULL};
+
+static scf_allocator allocator = {libc_alloc, libc_realloc, libc_free, NULL};
+
+static void *counting_alloc(void *context, size_t size) {
+    scf_allocation_counts *counts = context;
+    scf_atomic_add_u64(&counts->alloc_count, 1);
+    return malloc(size);
+}
+
+static void *counting_realloc(void *context, void *p, size_t size) {
+    scf_allocation_counts *counts = context;
+    scf_atomic_add_u64(&counts->realloc_count, 1);
+    return realloc(p, size);
+}
+
+static void counting_free(void *context, void *p) {
+    scf_allocation_counts *counts = context;
+    scf_atomic_add_u64(&counts->free_count, 1);
+    free(p);
+}
+
+scf_allocator scf_counting_allocator(scf_allocation_counts *counts) {
+    scf_allocator result = {counting_alloc, counting_realloc, counting_free, counts};
+    return result;
+}
+
+void scf_set_allocator(const scf_allocator *new_allocator) {
+    allocator = new_allocator ? *new_allocator : scf_libc_allocator;
+}
+
+static inline void free_raw(void *p) {
+    allocator.free(allocator.context, p);
+}
+
+static void *alloc_raw(void *original, size_t required) {
+    void *result = original
+        ? allocator.realloc(allocator.context, original, required)
+        : allocator.alloc(allocator.context, required);
+    if (result) {
+        return result;
+    }
+    
+    exhaustion_handler();
+    abort();
+}
+
+static inline size_t align_up(size_t n) {
+    return (n + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+static inline char *slab_data(scf_slab *slab) {
+    return (char *)slab + align_up(sizeof(scf_slab));
+}
+
+static inline bool uses_slabs(const scf_operation *operation) {
+    return operation->mode == SCF_OP_ARENA || operation->mode == SCF_OP_COMPACT;
+}
+
+static scf_slab *new_slab(scf_operation *operation) {
+    scf_slab *slab;
+    if (operation->spare_slabs) {
+        slab = operation->spare_slabs;
+        operation->spare_slabs = slab->next;
+    } else {
+        slab = alloc_raw(NULL, align_up(sizeof(scf_slab)) + SLAB_SIZE);
+        slab->capacity = SLAB_SIZE;
+    }
+    
+    slab->operation = operation;
+    slab->used = 0;
+    slab->sequence = operation->slabs ? operation->slabs->sequence + 1 : 0;
+    slab->next = operation->slabs;
+    operation->slabs = slab;
+    return slab;
+}
+
+static scf_mem_block *alloc_from_slab(scf_operation *operation, size_t required) {
+    size_t block_size = align_up(HEADER_SIZE + required);
+    scf_slab *slab = operation->slabs;
+    size_t start = slab ? align_up(slab->used) : 0;
+    if (!slab || start > slab->capacity || slab->capacity - start < block_size) {
+        slab = new_slab(operation);
+        start = 0;
+    }
+    
+    scf_mem_block *block = (scf_mem_block *)(slab_data(slab) + start);
+    slab->used = start + block_size;
+    block->flags = BLOCK_IN_SLAB;
+    return block;
+}
+
+/*
+ * Compact allocations.
+ */
+static inline uint32_t block_flags(const void *p) {
+    return ((const uint32_t *)p)[-1];
+}
+
+static inline void set_block_flags(void *p, uint32_t flags) {
+    ((uint32_t *)p)[-1] |= flags;
+}
+
+static inline bool is_compact(const void *p) {
+    return (block_flags(p) & BLOCK_COMPACT) != 0;
+}
+
+static inline compact_header *get_compact_header(const void *p) {
+    return (compact_header *)((char *)p - COMPACT_HEADER_SIZE);
+}
+
+static inline size_t compact_size(const compact_header *header) {
+    return header->flags >> COMPACT_SIZE_SHIFT;
+}
+
+static inline scf_slab *compact_slab(const compact_header *header) {
+    return (scf_slab *)((char *)header - header->offset);
+}
+
+static inline size_t compact_extent(size_t size) {
+    return (COMPACT_HEADER_SIZE + size + COMPACT_ALIGNMENT - 1) & ~(COMPACT_ALIGNMENT - 1);
+}
+
+static void *alloc_compact(scf_operation *operation, size_t required) {
+    size_t extent = compact_extent(required);
+    scf_slab *slab = operation->slabs;
+    if (!slab || slab->capacity - slab->used < extent) {
+        slab = new_slab(operation);
+    }
+    
+    compact_header *header = (compact_header *)(slab_data(slab) + slab->used);
+    slab->used += extent;
+    header->offset = (uint32_t)((char *)header - (char *)slab);
+    header->flags = BLOCK_COMPACT | ((uint32_t)required << COMPACT_SIZE_SHIFT);
+    return header + 1;
+}
+
+/*
+ * Whether a compact allocation is the most recent one in its operation's
+ * current slab, and so can be resized or released in place.
+ */
+static bool compact_at_slab_end(const compact_header *header) {
+    scf_slab *slab = compact_slab(header);
+    return slab == slab->operation->slabs
+        && (char *)header + compact_extent(compact_size(header)) == slab_data(slab) + slab->used;
+}
+
+/*
+ * The registry is indexed by allocation address in an open-addressed
+ * table of entry numbers. Slots are never removed: an entry that is
+ * released, moved or done with simply stops matching (its data no longer
+ * being the address looked up), and the index is rebuilt from the live
+ * entries when the slots in use reach three quarters of the table.
+ */
+#define EMPTY_INDEX_SLOT SIZE_MAX
+
+static inline size_t hash_address(const void *p) {
+    return scf_hash_uint64((uintptr_t)p);
+}
+
+static void insert_index_slot(scf_operation *operation, size_t entry) {
+    size_t mask = operation->cleanup_index_capacity - 1;
+    size_t slot = hash_address(operation->cleanups[entry].data) & mask;
+    while (operation->cleanup_index[slot] != EMPTY_INDEX_SLOT) {
+        slot = (slot + 1) & mask;
+    }
+    
+    operation->cleanup_index[slot] = entry;
+    operation->cleanup_index_used++;
+}
+
+static void rebuild_cleanup_index(scf_operation *operation) {
+    size_t capacity = 16;
+    while (capacity < 4 * operation->cleanup_count) {
+        capacity *= 2;
+    }
+    
+    if (capacity != operation->cleanup_index_capacity) {
+        operation->cleanup_index = alloc_raw(operation->cleanup_index, capacity * sizeof(size_t));
+        operation->cleanup_index_capacity = capacity;
+    }
+    
+    memset(operation->cleanup_index, 0xFF, capacity * sizeof(size_t));
+    operation->cleanup_index_used = 0;
+    for (size_t i = 0; i < operation->cleanup_count; i++) {
+        if (operation->cleanups[i].data) {
+            insert_index_slot(operation, i);
+        }
+    }
+}
+
+static void index_registered_cleanup(scf_operation *operation, size_t entry) {
+    if (4 * (operation->cleanup_index_used + 1) > 3 * operation->cleanup_index_capacity) {
+        rebuild_cleanup_index(operation);
+    } else {
+        insert_index_slot(operation, entry);
+    }
+}
+
+static void register_cleanup(scf_operation *operation, void *p, scf_cleanup_func cleanup) {
+    if (operation->cleanup_count == operation->cleanup_capacity) {
+        size_t capacity = operation->cleanup_capacity ? 2 * operation->cleanup_capacity : 16;
+        operation->cleanups = alloc_raw(operation->cleanups, capacity * sizeof(scf_registered_cleanup));
+        operation->cleanup_capacity = capacity;
+    }
+    
+    scf_registered_cleanup *entry = &operation->cleanups[operation->cleanup_count++];
+    entry->data = p;
+    entry->cleanup = cleanup;
+    index_registered_cleanup(operation, operation->cleanup_count - 1);
+    set_block_flags(p, BLOCK_REGISTERED);
+}
+
+/*
+ * Finds the registry entry for an allocation. At most one entry matches
+ * a given address, since entries stop matching once their allocation is
+ * released.
+ */
+static scf_registered_cleanup *find_registered_cleanup(scf_operation *operation, const void *p) {
+    if (!operation->cleanup_index_capacity) return NULL;
+    
+    size_t mask = operation->cleanup_index_capacity - 1;
+    for (size_t slot = hash_address(p) & mask;; slot = (slot + 1) & mask) {
+        size_t entry = operation->cleanup_index[slot];
+        if (entry == EMPTY_INDEX_SLOT) return NULL;
+        
+        if (entry < operation->cleanup_count && operation->cleanups[entry].data == p) {
+            return &operation->cleanups[entry];
+        }
+    }
+}
+
+static void move_registered_cleanup(scf_operation *operation, const void *from, void *to) {
+    scf_registered_cleanup *entry = find_registered_cleanup(operation, from);
+    if (entry) {
+        entry->data = to;
+        index_registered_cleanup(operation, entry - operation->cleanups);
+        set_block_flags(to, BLOCK_REGISTERED);
+    }
+}
+
+/*
+ * Removes an allocation's cleanup from the registry without running it,
+ * returning the cleanup.
+ */
+static scf_cleanup_func take_registered_cleanup(scf_operation *operation, const void *p) {
+    scf_registered_cleanup *entry = find_registered_cleanup(operation, p);
+    if (!entry) return NULL;
+    
+    scf_cleanup_func cleanup = entry->cleanup;
+    entry->data = NULL;
+    entry->cleanup = NULL;
+    return cleanup;
+}
+
+static void run_registered_cleanup(scf_operation *operation, const void *p) {
+    scf_registered_cleanup *entry = find_registered_cleanup(operation, p);
+    if (!entry) return;
+    
+    if (entry->cleanup) {
+        entry->cleanup(entry->data);
+    }
+    
+    entry->data = NULL;
+    entry->cleanup = NULL;
+}
+
+/*
+ * Runs the registered cleanups, most recent first, until only 'keep'
+ * remain.
+ */
+static void run_registered_cleanups(scf_operation *operation, size_t keep) {
+    while (operation->cleanup_count > keep) {
+        scf_registered_cleanup *entry = &operation->cleanups[--operation->cleanup_count];
+        if (entry->cleanup) {
+            entry->cleanup(entry->data);
+        }
+    }
+}
+
+static inline int floor_log2(size_t n) {
+    int result = 0;
+    while (n >>= 1) {
+        result++;
+    }
+    
+    return result;
+}
+
+/*
+ * The size class a block of the given capacity is filed under when it is
+ * freed, or -1 if it is too small or too large to be worth recycling.
+ * Every block in class n has a capacity of at least 2^(n + MIN_CLASS_SHIFT).
+ */
+static int free_size_class(size_t capacity) {
+    int size_class = floor_log2(capacity) - MIN_CLASS_SHIFT;
+    return (size_class < 0 || size_class >= SCF_SIZE_CLASSES) ? -1 : size_class;
+}
+
+/*
+ * The smallest size class whose blocks are all large enough for the
+ * request.
+ */
+static int ceil_size_class(size_t required) {
+    if (required <= ((size_t)1 << MIN_CLASS_SHIFT)) return 0;
+    return floor_log2(required - 1) + 1 - MIN_CLASS_SHIFT;
+}
+
+/*
+ * The size class from which a request can be satisfied, or -1 if the
+ * request is too large to be served from the free lists.
+ */
+static int alloc_size_class(size_t required) {
+    int size_class = ceil_size_class(required);
+    return size_class >= SCF_SIZE_CLASSES ? -1 : size_class;
+}
+
+/*
+ * Large blocks are given a mapping of their own, on platforms where the
+ * mapping can later be resized without copying.
+ */
+static inline bool use_mapping(size_t required) {
+#ifdef SCF_USE_MMAP
+    return scf_mmap_threshold && required >= scf_mmap_threshold && allocator.alloc == libc_alloc;
+#else
+    return false;
+#endif
+}
+
+#ifdef SCF_USE_MMAP
+static size_t mapping_length(size_t required) {
+    static size_t page_size;
+    if (!page_size) page_size = (size_t)sysconf(_SC_PAGESIZE);
+    return (HEADER_SIZE + required + page_size - 1) & ~(page_size - 1);
+}
+
+static scf_mem_block *map_block(size_t required) {
+    size_t length = mapping_length(required);
+    void *p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        exhaustion_handler();
+        abort();
+    }
+    
+#ifdef MADV_HUGEPAGE
+    madvise(p, length, MADV_HUGEPAGE);
+#endif
+    scf_mem_block *block = p;
+    block->flags = BLOCK_MAPPED;
+    block->size = required;
+    return block;
+}
+
+static scf_mem_block *remap_block(scf_mem_block *block, size_t required) {
+    size_t old_length = mapping_length(block->size);
+    size_t new_length = mapping_length(required);
+    if (new_length != old_length) {
+        void *p = mremap(block, old_length, new_length, MREMAP_MAYMOVE);
+        if (p == MAP_FAILED) {
+            exhaustion_handler();
+            abort();
+        }
+        
+#ifdef MADV_HUGEPAGE
+        madvise(p, new_length, MADV_HUGEPAGE);
+#endif
+        block = p;
+    }
+    
+    block->size = required;
+    return block;
+}
+#endif
+
+static scf_mem_block *alloc_block(scf_operation *operation, size_t required) {
+    int size_class = alloc_size_class(required);
+    if (size_class >= 0 && operation->free_blocks[size_class]) {
+        scf_mem_block *recycled = operation->free_blocks[size_class];
+        operation->free_blocks[size_class] = recycled->next;
+        return recycled;
+    }
+    
+    scf_mem_block *block;
+    if (uses_slabs(operation) && required <= MAX_SLAB_ALLOCATION) {
+        block = alloc_from_slab(operation, required);
+#ifdef SCF_USE_MMAP
+    } else if (use_mapping(required)) {
+        return map_block(required);
+#endif
+    } else {
+        block = alloc_raw(NULL, HEADER_SIZE + required);
+        block->flags = 0;
+    }
+    
+    block->size = required;
+    return block;
+}
+
+static inline size_t block_alignment(const scf_mem_block *block) {
+    return (size_t)1 << ((block->flags >> ALIGNMENT_SHIFT_POS) & ALIGNMENT_SHIFT_MASK);
+}
+
+/*
+ * Allocates a block whose data is aligned to the given power of two.
+ * The block header sits immediately before the data, 'offset' bytes
+ * into the underlying allocation.
+ */
+static scf_mem_block *alloc_aligned_block(size_t required, size_t alignment) {
+    char *raw = alloc_raw(NULL, HEADER_SIZE + required + alignment - 1);
+    uintptr_t data = ((uintptr_t)raw + HEADER_SIZE + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    scf_mem_block *block = (scf_mem_block *)(data - HEADER_SIZE);
+    block->offset = (uint32_t)((char *)block - raw);
+    block->flags = BLOCK_ALIGNED | ((uint32_t)floor_log2(alignment) << ALIGNMENT_SHIFT_POS);
+    block->size = required;
+    return block;
+}
+
+static void free_block(scf_mem_block *block) {
+    if (block->flags & BLOCK_IN_SLAB) return;
+    
+#ifdef SCF_USE_MMAP
+    if (block->flags & BLOCK_MAPPED) {
+        munmap(block, mapping_length(block->size));
+        return;
+    }
+#endif
+    
+    if (block->flags & BLOCK_ALIGNED) {
+        free_raw((char *)block - block->offset);
+    } else {
+        free_raw(block);
+    }
+}
+
+/*
+ * Attempts to resize a block in place. This is only possible when the
+ * block is the most recent allocation in its operation's current slab.
+ */
+static bool resize_in_slab(scf_mem_block *block, size_t required) {
+    if (!(block->flags & BLOCK_IN_SLAB)) return false;
+    
+    scf_slab *slab = block->operation->slabs;
+    char *end = (char *)block + align_up(HEADER_SIZE + block->size);
+    if (end != slab_data(slab) + slab->used) return false;
+    
+    size_t start = (char *)block - slab_data(slab);
+    size_t block_size = align_up(HEADER_SIZE + required);
+    if (block_size > slab->capacity - start) return false;
+    
+    slab->used = start + block_size;
+    block->size = required;
+    return true;
+}
+
+/*
+ * Returns a block's memory to its slab if it was the most recent
+ * allocation there.
+ */
+static bool release_in_slab(scf_mem_block *block) {
+    if (!(block->flags & BLOCK_IN_SLAB)) return false;
+    
+    scf_slab *slab = block->operation->slabs;
+    char *end = (char *)block + align_up(HEADER_SIZE + block->size);
+    if (end != slab_data(slab) + slab->used) return false;
+    
+    slab->used = (char *)block - slab_data(slab);
+    return true;
+}
+
+static scf_mem_block *get_block(const void *p) {
+    char *cp = (char *)p;
+    cp -= HEADER_SIZE;
+    return (scf_mem_block *) cp;
+}
+
+static void add_block(scf_operation *operation, scf_mem_block *block) {
+    block->operation = operation;
+    block->prev = NULL;
+    block->next = operation->first;
+    if (operation->first) {
+        operation->first->prev = block;
+    }
+    
+    operation->first = block;
+}
+
+static void remove_block(scf_mem_block *block) {
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        block->operation->first = block->next;
+    }
+    
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+}
+
+/*
+ * Points a block's neighbours back at it after it has moved in memory,
+ * so that it keeps its original position in the operation's list.
+ */
+static void relink_block(scf_mem_block *block) {
+    if (block->prev) {
+        block->prev->next = block;
+    } else {
+        block->operation->first = block;
+    }
+    
+    if (block->next) {
+        block->next->prev = block;
+    }
+}
+
+static uint64_t get_operation_id(scf_operation *operation) {
+    uint64_t id = scf_atomic_load_u64(&operation->id);
+    if (id == 0) {
+        uint64_t new_id = scf_atomic_add_u64(&next_operation_id, 1);
+        if (scf_atomic_cas_u64(&operation->id, &id, new_id)) {
+            id = new_id;
+        }
+    }
+    
+    return id;
+}
+
+static scf_operation *get_thread_cache(scf_operation *operation) {
+    uint64_t id = get_operation_id(operation);
+    for (int i = 0; i < THREAD_CACHE_ENTRIES; i++) {
+        if (thread_caches[i].operation == operation && thread_caches[i].id == id) {
+            return thread_caches[i].cache;
+        }
+    }
+    
+    scf_operation *cache = alloc_raw(NULL, sizeof(scf_operation));
+    memset(cache, 0, sizeof(scf_operation));
+    cache->mode = SCF_OP_ARENA;
+    cache->parent = operation;
+    cache->next_cache = scf_atomic_load_ptr(&operation->caches);
+    while (!scf_atomic_cas_ptr(&operation->caches, &cache->next_cache, cache))
+        ;
+    
+    thread_cache_entry *entry = &thread_caches[next_thread_cache++ % THREAD_CACHE_ENTRIES];
+    entry->operation = operation;
+    entry->id = id;
+    entry->cache = cache;
+    return cache;
+}
+
+static void update_live_bytes(scf_operation *operation, size_t released, size_t acquired) {
+    scf_memory_stats *stats = &operation->stats;
+    stats->live_bytes = stats->live_bytes - released + acquired;
+    if (stats->live_bytes > stats->peak_bytes) {
+        stats->peak_bytes = stats->live_bytes;
+    }
+    
+    if (operation->parent) {
+        operation->pending_live_bytes += (int64_t)acquired - (int64_t)released;
+        if (operation->pending_live_bytes >= SHARED_LIVE_BYTES_BATCH || operation->pending_live_bytes <= -SHARED_LIVE_BYTES_BATCH) {
+            scf_atomic_add_u64(&operation->parent->shared_live_bytes, (uint64_t)operation->pending_live_bytes);
+            operation->pending_live_bytes = 0;
+        }
+    }
+}
+
+/*
+ * The live bytes of the operation whose budget applies to an allocation.
+ * For a thread cache this is the concurrent operation's shared count as
+ * last published by all its caches, plus whatever this cache has not yet
+ * published.
+ */
+static size_t budgeted_live_bytes(const scf_operation *operation) {
+    if (!operation->parent) return operation->stats.live_bytes;
+    
+    int64_t live_bytes = (int64_t)scf_atomic_load_u64(&operation->parent->shared_live_bytes) + operation->pending_live_bytes;
+    return live_bytes > 0 ? (size_t)live_bytes : 0;
+}
+
+/*
+ * Returns false if the allocation should fail by returning NULL.
+ */
+static bool check_budget(scf_operation *operation, size_t growth) {
+    scf_operation *owner = operation->parent ? operation->parent : operation;
+    for (;;) {
+        if (!owner->budget) return true;
+        
+        size_t live_bytes = budgeted_live_bytes(operation);
+        if (growth <= owner->budget && live_bytes <= owner->budget - growth) return true;
+        
+        if (!owner->budget_handler || !owner->budget_handler(owner, growth)) {
+            if (owner->budget_failure == SCF_BUDGET_RETURN_NULL) return false;
+            
+            scf_raise_error(SCF_BUDGET_EXCEEDED, "Operation memory budget exceeded");
+        }
+    }
+}
+
+/*
+ * Sampling allocation profiler.
+ */
+static void lock_profile(void) {
+    uint64_t unlocked = 0;
+    while (!scf_atomic_cas_u64(&profile_lock, &unlocked, 1)) {
+        unlocked = 0;
+    }
+}
+
+static void unlock_profile(void) {
+    scf_atomic_store_u64(&profile_lock, 0);
+}
+
+/*
+ * The gap between samples is drawn uniformly from [1, 2 * interval], so
+ * that allocation patterns with a fixed period aren't systematically
+ * missed or over-counted.
+ */
+static size_t next_sample_gap(size_t interval) {
+    if (!profile_random) {
+        profile_random = (uint64_t)(uintptr_t)&profile_random | 1;
+    }
+    
+    profile_random ^= profile_random << 13;
+    profile_random ^= profile_random >> 7;
+    profile_random ^= profile_random << 17;
+    return 1 + profile_random % (2 * interval);
+}
+
+static size_t hash_tags(const char *const *tags, int depth) {
+    size_t h = 14695981039346656037ULL;
+    for (int i = 0; i < depth; i++) {
+        h = (h ^ (uintptr_t)tags[i]) * 1099511628211ULL;
+    }
+    
+    return h;
+}
+
+static void take_sample(size_t size, size_t interval) {
+    bytes_until_sample = next_sample_gap(interval);
+    
+    /*
+     * An allocation larger than the interval is always sampled, so it
+     * stands for itself; a smaller one stands for the interval's worth
+     * of allocations it was picked from.
+     */
+    size_t weight = size > interval ? size : interval;
+    int depth = profile_depth < SCF_PROFILE_MAX_DEPTH ? profile_depth : SCF_PROFILE_MAX_DEPTH;
+    const char *tags[SCF_PROFILE_MAX_DEPTH];
+    for (int i = 0; i < depth; i++) {
+        tags[i] = profile_tags[i].tag;
+    }
+    
+    size_t index = hash_tags(tags, depth) % PROFILE_MAX_STACKS;
+    lock_profile();
+    for (int probes = 0; probes < PROFILE_MAX_STACKS; probes++) {
+        profile_entry *entry = &profile_entries[index];
+        if (entry->samples == 0) {
+            entry->depth = depth;
+            memcpy(entry->tags, tags, depth * sizeof(const char *));
+        }
+        
+        if (entry->depth == depth && memcmp(entry->tags, tags, depth * sizeof(const char *)) == 0) {
+            entry->samples++;
+            entry->bytes += weight;
+            unlock_profile();
+            return;
+        }
+        
+        index = (index + 1) % PROFILE_MAX_STACKS;
+    }
+    
+    profile_overflow_bytes += weight;
+    unlock_profile();
+}
+
+static inline void profile_allocation(size_t size) {
+    size_t interval = (size_t)scf_atomic_load_u64(&profile_interval);
+    if (!interval) return;
+    
+    if (size < bytes_until_sample) {
+        bytes_until_sample -= size;
+        return;
+    }
+    
+    take_sample(size, interval);
+}
+
+void scf_profile_start(size_t sample_interval) {
+    lock_profile();
+    memset(profile_entries, 0, sizeof(profile_entries));
+    profile_overflow_bytes = 0;
+    scf_atomic_store_u64(&profile_interval, sample_interval);
+    unlock_profile();
+}
+
+void scf_profile_stop(void) {
+    scf_atomic_store_u64(&profile_interval, 0);
+}
+
+void scf_profile_push_tag(const char *tag) {
+    if (profile_depth > 0 && profile_depth <= SCF_PROFILE_MAX_DEPTH && profile_tags[profile_depth - 1].tag == tag) {
+        profile_tags[profile_depth - 1].repeats++;
+        return;
+    }
+    
+    if (profile_depth < SCF_PROFILE_MAX_DEPTH) {
+        profile_tags[profile_depth].tag = tag;
+        profile_tags[profile_depth].repeats = 0;
+    }
+    
+    profile_depth++;
+}
+
+void scf_profile_pop_tag(void) {
+    if (profile_depth == 0) scf_raise_error(SCF_LOGIC_ERROR, "Profile tag stack is empty");
+    
+    if (profile_depth <= SCF_PROFILE_MAX_DEPTH && profile_tags[profile_depth - 1].repeats > 0) {
+        profile_tags[profile_depth - 1].repeats--;
+        return;
+    }
+    
+    profile_depth--;
+}
+
+void scf_profile_write(FILE *out) {
+    lock_profile();
+    for (int i = 0; i < PROFILE_MAX_STACKS; i++) {
+        const profile_entry *entry = &profile_entries[i];
+        if (entry->samples == 0) continue;
+        
+        if (entry->depth == 0) {
+            fputs("[untagged]", out);
+        }
+        
+        for (int j = 0; j < entry->depth; j++) {
+            fprintf(out, j ? ";%s" : "%s", entry->tags[j]);
+        }
+        
+        fprintf(out, " %zu\n", entry->bytes);
+    }
+    
+    if (profile_overflow_bytes) {
+        fprintf(out, "[overflow] %zu\n", profile_overflow_bytes);
+    }
+    
+    unlock_profile();
+}
+
+static void record_alloc(scf_operation *operation, size_t required, size_t acquired) {
+    int bucket = ceil_size_class(required);
+    if (bucket >= SCF_HISTOGRAM_BUCKETS) bucket = SCF_HISTOGRAM_BUCKETS - 1;
+    operation->stats.histogram[bucket]++;
+    operation->stats.alloc_count++;
+    update_live_bytes(operation, 0, acquired);
+    profile_allocation(required);
+}
+
+inline static void check_not_pinned(const scf_buffer *buffer) {
+    if (buffer->pinned) scf_raise_error(SCF_LOGIC_ERROR, "Attempting to resize pinned buffer");
+}
+
+void *scf_alloc(scf_operation *operation, size_t required) {
+    return scf_alloc_with_cleanup(operation, NULL, required);
+}
+
+static void *alloc_full(scf_operation *operation, size_t required) {
+    scf_mem_block *block = alloc_block(operation, required);
+    block->cleanup = NULL;
+    add_block(operation, block);
+    record_alloc(operation, required, block->size);
+    return block->data;
+}
+
+static void set_cleanup(scf_operation *operation, void *p, scf_cleanup_func cleanup) {
+    if (operation->mode == SCF_OP_COMPACT) {
+        if (cleanup) register_cleanup(operation, p, cleanup);
+    } else {
+        get_block(p)->cleanup = cleanup;
+    }
+}
+
+void *scf_alloc_with_cleanup(scf_operation *operation, scf_cleanup_func cleanup, size_t required) {
+    if (operation->mode == SCF_OP_CONCURRENT) {
+        operation = get_thread_cache(operation);
+    }
+    
+    if (!check_budget(operation, required)) return NULL;
+    
+    void *result;
+    if (operation->mode == SCF_OP_COMPACT && required <= MAX_COMPACT_ALLOCATION) {
+        result = alloc_compact(operation, required);
+        record_alloc(operation, required, required);
+    } else {
+        result = alloc_full(operation, required);
+    }
+    
+    set_cleanup(operation, result, cleanup);
+    return result;
+}
+
+void *scf_alloc_aligned(scf_operation *operation, size_t required, size_t alignment) {
+    return scf_alloc_aligned_with_cleanup(operation, NULL, required, alignment);
+}
+
+void *scf_alloc_aligned_with_cleanup(scf_operation *operation, scf_cleanup_func cleanup, size_t required, size_t alignment) {
+    if (alignment == 0 || (alignment & (alignment - 1))) scf_raise_error(SCF_LOGIC_ERROR, "Alignment must be a power of two");
+    if (operation->mode == SCF_OP_CONCURRENT) {
+        operation = get_thread_cache(operation);
+    }
+    
+    if (!check_budget(operation, required)) return NULL;
+    
+    void *result;
+    if (alignment <= ALIGNMENT) {
+        result = alloc_full(operation, required);
+    } else {
+        scf_mem_block *block = alloc_aligned_block(required, alignment);
+        add_block(operation, block);
+        record_alloc(operation, required, block->size);
+        result = block->data;
+    }
+    
+    set_cleanup(operation, result, cleanup);
+    return result;
+}
+
+static marker_info get_marker_info(const scf_mem_block *marker) {
+    marker_info info;
+    memcpy(&info, marker->data, sizeof(marker_info));
+    return info;
+}
+
+/*
+ * Whether a compact allocation was made before the given mark.
+ */
+static bool compact_predates_marker(const compact_header *header, const scf_mem_block *marker) {
+    marker_info info = get_marker_info(marker);
+    scf_slab *slab = compact_slab(header);
+    if (!info.slab) return false;
+    if (slab == info.slab) return (size_t)((char *)header - slab_data(slab)) < info.used;
+    
+    return slab->sequence < info.slab->sequence;
+}
+
+/*
+ * Links in the block that a compact allocation has moved to while a mark
+ * is outstanding, so that releasing to a mark frees it exactly when it
+ * would have reclaimed the original: just after the oldest marker taken
+ * since the original was allocated, or at the head of the list if there
+ * is none. Only the outstanding marks are visited.
+ */
+static void link_moved_compact(scf_operation *operation, const compact_header *original, scf_mem_block *block) {
+    scf_mem_block *after = NULL;
+    for (scf_mem_block *marker = operation->last_marker; marker && compact_predates_marker(original, marker);) {
+        after = marker;
+        marker = get_marker_info(marker).previous_marker;
+    }
+    
+    if (!after) {
+        add_block(operation, block);
+        return;
+    }
+    
+    block->operation = operation;
+    block->prev = after;
+    block->next = after->next;
+    if (after->next) {
+        after->next->prev = block;
+    }
+    
+    after->next = block;
+}
+
+static void *realloc_compact(void *p, size_t required) {
+    compact_header *header = get_compact_header(p);
+    scf_slab *slab = compact_slab(header);
+    scf_operation *operation = slab->operation;
+    size_t original_size = compact_size(header);
+    if (required > original_size) {
+        if (!check_budget(operation, required - original_size)) return NULL;
+        
+        profile_allocation(required - original_size);
+    }
+    
+    operation->stats.realloc_count++;
+    if (required <= MAX_COMPACT_ALLOCATION && compact_at_slab_end(header)) {
+        size_t start = (char *)header - slab_data(slab);
+        if (compact_extent(required) <= slab->capacity - start) {
+            slab->used = start + compact_extent(required);
+            header->flags = (header->flags & COMPACT_FLAGS_MASK) | ((uint32_t)required << COMPACT_SIZE_SHIFT);
+            update_live_bytes(operation, original_size, required);
+            return p;
+        }
+    }
+    
+    /*
+     * As for slab blocks, an allocation that moves while a mark is
+     * outstanding must be kept clear of slab space that a release could
+     * reclaim.
+     */
+    void *result;
+    size_t acquired = required;
+    if (operation->marks) {
+        scf_mem_block *block = alloc_raw(NULL, HEADER_SIZE + required);
+        block->flags = 0;
+        block->size = required;
+        block->cleanup = NULL;
+        link_moved_compact(operation, header, block);
+        result = block->data;
+    } else if (required <= MAX_COMPACT_ALLOCATION) {
+        result = alloc_compact(operation, required);
+    } else {
+        scf_mem_block *block = alloc_block(operation, required);
+        block->cleanup = NULL;
+        add_block(operation, block);
+        result = block->data;
+        acquired = block->size;
+    }
+    
+    memcpy(result, p, original_size < required ? original_size : required);
+    if (header->flags & BLOCK_REGISTERED) {
+        move_registered_cleanup(operation, p, result);
+    }
+    
+    update_live_bytes(operation, original_size, acquired);
+    return result;
+}
 
-static const int HEADER_SIZE = offsetof(scf_mem_block, data);
-static const int MIN_CAPACITY = 4;
+void *scf_realloc(void *p, size_t required) {
+    if (is_compact(p)) {
+        return realloc_compact(p, required);
+    }
+    
+    scf_mem_block *original_block = get_block(p);
+    scf_operation *operation = original_block->operation;
+    size_t original_size = original_block->size;
+    if (required > original_size) {
+        if (!check_budget(operation, required - original_size)) return NULL;
+        
+        profile_allocation(required - original_size);
+    }
+    
+    operation->stats.realloc_count++;
+    if (resize_in_slab(original_block, required)) {
+        update_live_bytes(operation, original_size, required);
+        return p;
+    }
+    
+    scf_mem_block *new_block;
+#ifdef SCF_USE_MMAP
+    if (original_block->flags & BLOCK_MAPPED) {
+        new_block = remap_block(original_block, required);
+        relink_block(new_block);
+        if (new_block->data != p && (new_block->flags & BLOCK_REGISTERED)) {
+            move_registered_cleanup(operation, p, new_block->data);
+        }
+        
+        update_live_bytes(operation, original_size, new_block->size);
+        return new_block->data;
+    }
+#endif
+    
+    if (original_block->flags & (BLOCK_IN_SLAB | BLOCK_ALIGNED) || use_mapping(required)) {
+        /*
+         * While a mark is outstanding the block may predate it, in which
+         * case it must not move into slab space that a release would reclaim.
+         */
+        if (original_block->flags & BLOCK_ALIGNED) {
+            new_block = alloc_aligned_block(required, block_alignment(original_block));
+        } else if (use_mapping(required)) {
+            new_block = alloc_block(operation, required);
+        } else if (operation->marks) {
+            new_block = alloc_raw(NULL, HEADER_SIZE + required);
+            new_block->flags = 0;
+            new_block->size = required;
+        } else {
+            new_block = alloc_block(operation, required);
+        }
+        
+        memcpy(new_block->data, original_block->data, original_size < required ? original_size : required);
+        new_block->operation = operation;
+        new_block->prev = original_block->prev;
+        new_block->next = original_block->next;
+        new_block->cleanup = original_block->cleanup;
+        new_block->flags |= original_block->flags & BLOCK_REGISTERED;
+        free_block(original_block);
+    } else {
+        new_block = alloc_raw(original_block, required + HEADER_SIZE);
+        new_block->size = required;
+    }
+    
+    relink_block(new_block);
+    if (new_block->data != p && (new_block->flags & BLOCK_REGISTERED)) {
+        move_registered_cleanup(operation, p, new_block->data);
+    }
+    
+    update_live_bytes(operation, original_size, new_block->size);
+    return new_block->data;
+}
 
-static void default_exhaustion_handler(void) {
-    fprintf(stderr, "Out of memory!\n");
-    exit(1);
+static void free_blocks(scf_mem_block *block) {
+    while (block) {
+        scf_mem_block *next = block->next;
+        free_block(block);
+        block = next;
+    }
 }
 
-scf_exhaustion_handler exhaustion_handler = default_exhaustion_handler;
+static void flush_free_blocks(scf_operation *operation) {
+    for (int i = 0; i < SCF_SIZE_CLASSES; i++) {
+        free_blocks(operation->free_blocks[i]);
+        operation->free_blocks[i] = NULL;
+    }
+}
 
-static void *alloc_raw(void *original, size_t required) {
-    void *result = realloc(original, required);
-    if (result) {
-        return result;
+scf_mark scf_operation_mark(scf_operation *operation) {
+    if (operation->mode == SCF_OP_CONCURRENT) scf_raise_error(SCF_LOGIC_ERROR, "Marks are not supported on concurrent operations");
+    
+    marker_info info = {
+        operation->slabs,
+        operation->slabs ? operation->slabs->used : 0,
+        operation->cleanup_count,
+        operation->stats.live_bytes,
+        operation->last_marker
+    };
+    scf_mem_block *marker;
+    if (uses_slabs(operation)) {
+        marker = alloc_from_slab(operation, sizeof(marker_info));
+    } else {
+        marker = alloc_raw(NULL, HEADER_SIZE + sizeof(marker_info));
+        marker->flags = 0;
     }
     
-    exhaustion_handler();
-    abort();
+    marker->flags |= BLOCK_MARKER;
+    marker->size = sizeof(marker_info);
+    marker->cleanup = NULL;
+    memcpy(marker->data, &info, sizeof(marker_info));
+    add_block(operation, marker);
+    operation->last_marker = marker;
+    operation->marks++;
+    return marker->data;
 }
 
-static scf_mem_block *get_block(const void *p) {
-    char *cp = (char *)p;
-    cp -= HEADER_SIZE;
-    return (scf_mem_block *) cp;
+void scf_operation_release_to(scf_operation *operation, scf_mark mark) {
+    scf_mem_block *marker = get_block(mark);
+    marker_info info = get_marker_info(marker);
+    run_registered_cleanups(operation, info.cleanup_count);
+    
+    scf_mem_block *block;
+    for (block = operation->first; block != marker; block = block->next) {
+        if (block->cleanup) {
+            block->cleanup(block->data);
+        }
+    }
+    
+    block = operation->first;
+    while (block != marker) {
+        scf_mem_block *next = block->next;
+        if (block->flags & BLOCK_MARKER) {
+            operation->marks--;
+        } else {
+            update_live_bytes(operation, block->size, 0);
+        }
+        
+        free_block(block);
+        block = next;
+    }
+    
+    operation->first = marker->next;
+    if (marker->next) {
+        marker->next->prev = NULL;
+    }
+    
+    operation->marks--;
+    operation->last_marker = info.previous_marker;
+    
+    /*
+     * The free lists may hold blocks allocated after the mark, so they
+     * are discarded rather than picked through.
+     */
+    flush_free_blocks(operation);
+    
+    free_block(marker);
+    if (operation->mode == SCF_OP_COMPACT) {
+        operation->stats.live_bytes = info.live_bytes;
+    }
+    
+    while (operation->slabs != info.slab) {
+        scf_slab *slab = operation->slabs;
+        operation->slabs = slab->next;
+        slab->next = operation->spare_slabs;
+        operation->spare_slabs = slab;
+    }
+    
+    if (info.slab) {
+        info.slab->used = info.used;
+    }
 }
 
-static void add_block(scf_operation *operation, scf_mem_block *block) {
-    block->operation = operation;
-    block->next = operation->first;
-    operation->first = block;
+static void free_compact(void *p) {
+    compact_header *header = get_compact_header(p);
+    scf_slab *slab = compact_slab(header);
+    scf_operation *operation = slab->operation;
+    if (header->flags & BLOCK_REGISTERED) {
+        run_registered_cleanup(operation, p);
+        header->flags &= ~BLOCK_REGISTERED;
+    }
+    
+    update_live_bytes(operation, compact_size(header), 0);
+    if (compact_at_slab_end(header)) {
+        slab->used = (char *)header - slab_data(slab);
+    }
 }
 
-static void remove_block(scf_mem_block *block) {
-    scf_operation *operation = block->operation;
-    if (block == operation->first) {
-        operation->first = block->next;
+void scf_free(void *p) {
+    if (!p) return;
+    
+    if (is_compact(p)) {
+        free_compact(p);
         return;
     }
     
-    for (scf_mem_block *current = operation->first; current; current = current->next) {
-        if (current->next == block) {
-            current->next = block->next;
-            return;
-        }
+    scf_mem_block *block = get_block(p);
+    if (block->cleanup) {
+        block->cleanup(block->data);
+        block->cleanup = NULL;
+    }
+    
+    if (block->flags & BLOCK_REGISTERED) {
+        run_registered_cleanup(block->operation, p);
+        block->flags &= ~BLOCK_REGISTERED;
+    }
+    
+    remove_block(block);
+    update_live_bytes(block->operation, block->size, 0);
+    if (release_in_slab(block)) return;
+    
+    int size_class = free_size_class(block->size);
+    if (size_class >= 0) {
+        scf_operation *operation = block->operation;
+        block->next = operation->free_blocks[size_class];
+        operation->free_blocks[size_class] = block;
+    } else {
+        free_block(block);
     }
 }
 
-inline static void check_not_pinned(const scf_buffer *buffer) {
-    if (buffer->pinned) scf_raise_error(SCF_LOGIC_ERROR, "Attempting to resize pinned buffer");
+/*
+ * Moves an allocation whose memory belongs to its operation's slabs by
+ * copying it into the destination and releasing the original without
+ * running its cleanup.
+ */
+static void *transfer_by_copy(void *p, scf_operation *dest) {
+    scf_operation *source;
+    scf_cleanup_func cleanup;
+    size_t size;
+    if (is_compact(p)) {
+        compact_header *header = get_compact_header(p);
+        source = compact_slab(header)->operation;
+        size = compact_size(header);
+        if (!check_budget(dest, size)) return NULL;
+        
+        cleanup = (header->flags & BLOCK_REGISTERED) ? take_registered_cleanup(source, p) : NULL;
+    } else {
+        scf_mem_block *block = get_block(p);
+        source = block->operation;
+        size = block->size;
+        if (!check_budget(dest, size)) return NULL;
+        
+        cleanup = block->cleanup;
+        if (block->flags & BLOCK_REGISTERED) {
+            cleanup = take_registered_cleanup(source, p);
+        }
+    }
+    
+    void *result = scf_alloc_with_cleanup(dest, cleanup, size);
+    memcpy(result, p, size);
+    if (is_compact(p)) {
+        get_compact_header(p)->flags &= ~BLOCK_REGISTERED;
+    } else {
+        get_block(p)->cleanup = NULL;
+        get_block(p)->flags &= ~BLOCK_REGISTERED;
+    }
+    
+    scf_free(p);
+    return result;
 }
 
-void *scf_alloc(scf_operation *operation, size_t required) {
-    return scf_alloc_with_cleanup(operation, NULL, required);
+void *scf_transfer(void *p, scf_operation *dest) {
+    if (!p) return NULL;
+    
+    if (dest->mode == SCF_OP_CONCURRENT) {
+        dest = get_thread_cache(dest);
+    }
+    
+    if (is_compact(p) || (get_block(p)->flags & BLOCK_IN_SLAB)) {
+        if (scf_get_operation(p) == (dest->parent ? dest->parent : dest)) return p;
+        
+        return transfer_by_copy(p, dest);
+    }
+    
+    scf_mem_block *block = get_block(p);
+    scf_operation *source = block->operation;
+    if (source == dest) return p;
+    
+    if (!check_budget(dest, block->size)) return NULL;
+    
+    if (block->flags & BLOCK_REGISTERED) {
+        block->cleanup = take_registered_cleanup(source, p);
+        block->flags &= ~BLOCK_REGISTERED;
+    }
+    
+    remove_block(block);
+    update_live_bytes(source, block->size, 0);
+    add_block(dest, block);
+    update_live_bytes(dest, 0, block->size);
+    return p;
 }
 
-void *scf_alloc_with_cleanup(scf_operation *operation, scf_cleanup_func cleanup, size_t required) {
-    required += HEADER_SIZE;
-    scf_mem_block *block = alloc_raw(NULL, required);
-    block->cleanup = cleanup;
-    add_block(operation, block);
-    return block->data;
+scf_buffer *scf_buffer_transfer(scf_buffer *buffer, scf_operation *dest) {
+    if (buffer->pinned) return buffer;
+    
+    if (buffer->data) {
+        unsigned char *data = scf_transfer(buffer->data, dest);
+        if (!data) return NULL;
+        
+        buffer->data = data;
+    }
+    
+    buffer->operation = dest;
+    return buffer;
 }
 
-void *scf_realloc(void *p, size_t required) {
-    scf_mem_block *original_block = get_block(p);
-    scf_operation *operation = original_block->operation;
-    remove_block(original_block);
-    scf_mem_block *new_block = alloc_raw(original_block, required + HEADER_SIZE);
-    add_block(operation, new_block);
-    return new_block->data;
+static void complete_thread_caches(scf_operation *operation) {
+    scf_operation *cache = scf_atomic_exchange_ptr(&operation->caches, NULL);
+    while (cache) {
+        scf_operation *next = cache->next_cache;
+        scf_complete(cache);
+        free_raw(cache);
+        cache = next;
+    }
+    
+    scf_atomic_store_u64(&operation->id, 0);
 }
 
-void scf_complete(scf_operation *operation) {
-    scf_mem_block *block;
-    for (block = operation->first; block; block = block->next) {
+static void run_cleanups(scf_mem_block *block) {
+    for (; block; block = block->next) {
         if (block->cleanup) {
             block->cleanup(block->data);
         }
     }
+}
+
+static void free_slabs(scf_slab *slab) {
+    while (slab) {
+        scf_slab *next = slab->next;
+        free_raw(slab);
+        slab = next;
+    }
+}
 
-    block = operation->first;
+void scf_complete(scf_operation *operation) {
+    if (operation->mode == SCF_OP_CONCURRENT) {
+        complete_thread_caches(operation);
+    }
+    
+    run_registered_cleanups(operation, 0);
+    run_cleanups(operation->first);
+    free_blocks(operation->first);
+    flush_free_blocks(operation);
+    free_slabs(operation->slabs);
+    free_slabs(operation->spare_slabs);
+    if (operation->cleanups) {
+        free_raw(operation->cleanups);
+        free_raw(operation->cleanup_index);
+    }
+    
+    operation->cleanups = NULL;
+    operation->cleanup_capacity = 0;
+    operation->cleanup_index = NULL;
+    operation->cleanup_index_capacity = 0;
+    operation->cleanup_index_used = 0;
+    operation->first = NULL;
+    operation->slabs = NULL;
+    operation->spare_slabs = NULL;
+    operation->marks = 0;
+    operation->last_marker = NULL;
+    memset(&operation->stats, 0, sizeof(scf_memory_stats));
+    operation->pending_live_bytes = 0;
+    scf_atomic_store_u64(&operation->shared_live_bytes, 0);
+}
+
+/*
+ * Keeps as many slabs as the retention limit allows, emptied and ready
+ * for reuse, and frees the rest.
+ */
+static void retain_slabs(scf_operation *operation, scf_slab *slab, size_t *retained) {
+    while (slab) {
+        scf_slab *next = slab->next;
+        if (*retained + slab->capacity <= operation->retention) {
+            slab->used = 0;
+            slab->next = operation->spare_slabs;
+            operation->spare_slabs = slab;
+            *retained += slab->capacity;
+        } else {
+            free_raw(slab);
+        }
+        
+        slab = next;
+    }
+}
+
+/*
+ * Moves as many individually allocated blocks onto the free lists as
+ * the retention limit allows, and frees the rest. Slab blocks are simply
+ * dropped, since their slabs are being emptied.
+ */
+static void retain_blocks(scf_operation *operation, scf_mem_block *block, size_t *retained) {
     while (block) {
         scf_mem_block *next = block->next;
-        free(block);
+        int size_class = free_size_class(block->size);
+        if (!(block->flags & (BLOCK_IN_SLAB | BLOCK_MARKER | BLOCK_MAPPED))
+            && size_class >= 0
+            && *retained + block->size <= operation->retention) {
+            block->cleanup = NULL;
+            block->flags &= ~BLOCK_REGISTERED;
+            block->next = operation->free_blocks[size_class];
+            operation->free_blocks[size_class] = block;
+            *retained += block->size;
+        } else {
+            free_block(block);
+        }
+        
         block = next;
     }
+}
+
+void scf_operation_reset(scf_operation *operation) {
+    if (operation->mode == SCF_OP_CONCURRENT) {
+        for (scf_operation *cache = scf_atomic_load_ptr(&operation->caches); cache; cache = cache->next_cache) {
+            cache->retention = operation->retention;
+            scf_operation_reset(cache);
+        }
+    }
+    
+    run_registered_cleanups(operation, 0);
+    run_cleanups(operation->first);
+    
+    /*
+     * Slabs are retained in preference to individual blocks, but the
+     * blocks must be dealt with first since some of them live in the slabs.
+     */
+    size_t retained = 0;
+    for (scf_slab *slab = operation->slabs; slab; slab = slab->next) {
+        retained += slab->capacity;
+    }
+    
+    for (scf_slab *slab = operation->spare_slabs; slab; slab = slab->next) {
+        retained += slab->capacity;
+    }
+    
+    if (retained > operation->retention) retained = operation->retention;
+    
+    scf_mem_block *first = operation->first;
+    scf_mem_block *free_lists[SCF_SIZE_CLASSES];
+    memcpy(free_lists, operation->free_blocks, sizeof(free_lists));
+    memset(operation->free_blocks, 0, sizeof(free_lists));
+    for (int i = 0; i < SCF_SIZE_CLASSES; i++) {
+        retain_blocks(operation, free_lists[i], &retained);
+    }
     
+    retain_blocks(operation, first, &retained);
     operation->first = NULL;
+    
+    size_t retained_slab_bytes = 0;
+    scf_slab *slabs = operation->slabs;
+    scf_slab *spare_slabs = operation->spare_slabs;
+    operation->slabs = NULL;
+    operation->spare_slabs = NULL;
+    retain_slabs(operation, slabs, &retained_slab_bytes);
+    retain_slabs(operation, spare_slabs, &retained_slab_bytes);
+    
+    operation->marks = 0;
+    operation->last_marker = NULL;
+    memset(&operation->stats, 0, sizeof(scf_memory_stats));
+    operation->pending_live_bytes = 0;
+    scf_atomic_store_u64(&operation->shared_live_bytes, 0);
+}
+
+void scf_operation_set_retention(scf_operation *operation, size_t bytes) {
+    operation->retention = bytes;
+}
+
+static void add_stats(scf_memory_stats *total, const scf_memory_stats *stats) {
+    total->live_bytes += stats->live_bytes;
+    total->peak_bytes += stats->peak_bytes;
+    total->alloc_count += stats->alloc_count;
+    total->realloc_count += stats->realloc_count;
+    for (int i = 0; i < SCF_HISTOGRAM_BUCKETS; i++) {
+        total->histogram[i] += stats->histogram[i];
+    }
+}
+
+scf_memory_stats scf_operation_stats(const scf_operation *operation) {
+    scf_memory_stats result = operation->stats;
+    if (operation->mode == SCF_OP_CONCURRENT) {
+        for (scf_operation *cache = scf_atomic_load_ptr(&((scf_operation *)operation)->caches); cache; cache = cache->next_cache) {
+            add_stats(&result, &cache->stats);
+        }
+    }
+    
+    return result;
+}
+
+void scf_operation_set_budget(scf_operation *operation, size_t budget, scf_budget_handler handler) {
+    operation->budget = budget;
+    operation->budget_handler = handler;
+}
+
+void scf_operation_set_budget_failure(scf_operation *operation, scf_budget_failure failure) {
+    operation->budget_failure = failure;
+}
+
+void *scf_require_allocation(void *p) {
+    if (!p) scf_raise_error(SCF_BUDGET_EXCEEDED, "Operation memory budget exceeded");
+    
+    return p;
 }
 
 scf_operation *scf_get_operation(const void *p) {
-    return get_block(p)->operation;
+    scf_operation *operation = is_compact(p) ? compact_slab(get_compact_header(p))->operation : get_block(p)->operation;
+    return operation->parent ? operation->parent : operation;
 }
 
 
 
 
+/*
+ * Resizes the buffer's storage. A buffer that outgrows its inline
+ * storage spills into an allocation from its operation. If the
+ * allocation fails the buffer is left unchanged.
+ */
+static void set_capacity(scf_buffer *buffer, size_t new_capacity) {
+    if (buffer->data) {
+        buffer->data = scf_require_allocation(scf_realloc(buffer->data, new_capacity));
+    } else {
+        buffer->data = scf_require_allocation(scf_alloc(buffer->operation, new_capacity));
+        memcpy(buffer->data, buffer->inline_data, buffer->size);
+    }
+    
+    buffer->capacity = new_capacity;
+}
+
+size_t scf_grown_capacity(size_t capacity, double growth_factor, size_t required, size_t limit) {
+    if (required > limit) scf_raise_error(SCF_OUT_OF_MEMORY, "Requested capacity is too large");
+    
+    double grown = (growth_factor ? growth_factor : SCF_DEFAULT_GROWTH_FACTOR) * (double)capacity;
+    size_t new_capacity = grown < (double)limit ? (size_t)grown : limit;
+    if (new_capacity > limit) new_capacity = limit;
+    
+    return new_capacity < required ? required : new_capacity;
+}
+
+/*
+ * Grows the buffer by its growth factor, or further if that would not
+ * hold 'required' bytes.
+ */
 static void ensure_capacity(scf_buffer *buffer, size_t required) {
     if (buffer->capacity < required) {
-        size_t new_capacity = 2 * buffer->capacity;
-        if (new_capacity < required) new_capacity = required;
-        buffer->data = scf_realloc(buffer->data, new_capacity);
-        buffer->capacity = new_capacity;
+        set_capacity(buffer, scf_grown_capacity(buffer->capacity, buffer->growth_factor, required, SIZE_MAX));
     }
 }
 
 scf_buffer scf_buffer_create(scf_operation *operation, size_t initial_capacity) {
+    scf_buffer result = {0, SCF_BUFFER_INLINE_CAPACITY, false, NULL, operation, 0, {0}};
+    if (initial_capacity > SCF_BUFFER_INLINE_CAPACITY) {
+        result.data = scf_require_allocation(scf_alloc(operation, initial_capacity));
+        result.capacity = initial_capacity;
+    }
+    
+    return result;
+}
+
+scf_buffer scf_buffer_create_aligned(scf_operation *operation, size_t initial_capacity, size_t alignment) {
     if (initial_capacity < MIN_CAPACITY) initial_capacity = MIN_CAPACITY;
-    scf_buffer result = {0, initial_capacity, false, scf_alloc(operation, initial_capacity)};
+    unsigned char *data = scf_require_allocation(scf_alloc_aligned(operation, initial_capacity, alignment));
+    scf_buffer result = {0, initial_capacity, false, data, operation, 0, {0}};
     return result;
 }
 
 scf_buffer scf_buffer_wrap(void *data, size_t length) {
-    scf_buffer result = {length, length, true, data};
+    scf_buffer result = {length, length, true, data, NULL, 0, {0}};
     return result;
 }
 
 void scf_buffer_append_bytes(scf_buffer *buffer, const void *bytes_to_append, size_t byte_count) {
     check_not_pinned(buffer);
     ensure_capacity(buffer, buffer->size + byte_count);
-    memcpy(buffer->data + buffer->size, bytes_to_append, byte_count);
+    memcpy(scf_buffer_data(buffer) + buffer->size, bytes_to_append, byte_count);
     buffer->size += byte_count;
 }
 
 void scf_buffer_insert_bytes(scf_buffer *buffer, const void *bytes_to_insert, size_t before, size_t byte_count) {
     check_not_pinned(buffer);
     if (before > buffer->size) scf_raise_error(SCF_BAD_INDEX, "Invalid index");
-
+    
     if (byte_count == 0) return;
     
     ensure_capacity(buffer, buffer->size + byte_count);
-    memmove(buffer->data + before + byte_count, buffer->data + before, buffer->size - before);
-    memcpy(buffer->data + before, bytes_to_insert, byte_count);
+    unsigned char *data = scf_buffer_data(buffer);
+    memmove(data + before + byte_count, data + before, buffer->size - before);
+    memcpy(data + before, bytes_to_insert, byte_count);
     buffer->size += byte_count;
 }
 
 void scf_buffer_remove(scf_buffer *buffer, size_t starting_from, size_t byte_count) {
     check_not_pinned(buffer);
     if (starting_from + byte_count > buffer->size) scf_raise_error(SCF_BAD_INDEX, "Attempting to remove more data than is present!");
-
+    
     if (byte_count == 0) return;
     
-    memmove(buffer->data + starting_from, buffer->data + starting_from + byte_count, buffer->size - (starting_from + byte_count));
+    unsigned char *data = scf_buffer_data(buffer);
+    memmove(data + starting_from, data + starting_from + byte_count, buffer->size - (starting_from + byte_count));
     buffer->size -= byte_count;
 }
 
 scf_buffer scf_buffer_extract(const scf_buffer *buffer, size_t starting_from, size_t byte_count) {
     if (starting_from + byte_count > buffer->size) scf_raise_error(SCF_BAD_INDEX, "Attempting to extract more data than is present!");
-
-    scf_buffer result = scf_buffer_create(scf_get_operation(buffer->data), byte_count);
-    memcpy(result.data, buffer->data + starting_from, byte_count);
+    
+    scf_buffer result = scf_buffer_create(buffer->operation, byte_count);
+    memcpy(scf_buffer_data(&result), scf_buffer_data(buffer) + starting_from, byte_count);
     result.size = byte_count;
     return result;
 }
 
+void scf_buffer_reserve(scf_buffer *buffer, size_t capacity) {
+    if (buffer->capacity >= capacity) return;
+    
+    check_not_pinned(buffer);
+    set_capacity(buffer, capacity);
+}
+
+void scf_buffer_shrink_to_fit(scf_buffer *buffer) {
+    check_not_pinned(buffer);
+    if (!buffer->data) return;
+    
+    size_t new_capacity = buffer->size;
+    if (new_capacity < (size_t)MIN_CAPACITY) new_capacity = MIN_CAPACITY;
+    if (new_capacity < buffer->capacity) {
+        buffer->data = scf_realloc(buffer->data, new_capacity);
+        buffer->capacity = new_capacity;
+    }
+}
+
+void scf_buffer_set_growth_factor(scf_buffer *buffer, double growth_factor) {
+    if (!(growth_factor > 1.0)) scf_raise_error(SCF_LOGIC_ERROR, "Growth factor must be greater than 1");
+    
+    buffer->growth_factor = growth_factor;
+}
+
+#ifndef WIN32
+typedef struct {
+    void *address;
+    size_t length;
+} file_mapping;
+
+static void unmap_file(void *p) {
+    file_mapping *mapping = p;
+    if (mapping->address) {
+        munmap(mapping->address, mapping->length);
+    }
+}
+
+scf_buffer scf_buffer_map_file(scf_operation *operation, const char *path) {
+    /*
+     * The record is allocated first, so that neither the descriptor nor
+     * the mapping is leaked if the allocation fails.
+     */
+    file_mapping *mapping = scf_alloc_with_cleanup(operation, unmap_file, sizeof(file_mapping));
+    mapping->address = NULL;
+    
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) scf_raise_os_error(errno, "Unable to open file for mapping");
+    
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        int error = errno;
+        close(fd);
+        scf_raise_os_error(error, "Unable to determine size of file for mapping");
+    }
+    
+    scf_buffer result = scf_buffer_wrap(NULL, 0);
+    result.operation = operation;
+    if (info.st_size == 0) {
+        close(fd);
+        return result;
+    }
+    
+    size_t length = (size_t)info.st_size;
+    void *address = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    int error = errno;
+    close(fd);
+    if (address == MAP_FAILED) scf_raise_os_error(error, "Unable to map file");
+    
+    madvise(address, length, MADV_SEQUENTIAL);
+    mapping->address = address;
+    mapping->length = length;
+    
+    result.data = address;
+    result.size = length;
+    result.capacity = length;
+    return result;
+}
+#endif
+
+scf_buffer_view scf_buffer_view_extract(scf_buffer_view view, size_t starting_from, size_t byte_count) {
+    if (starting_from > view.size || byte_count > view.size - starting_from) scf_raise_error(SCF_BAD_INDEX, "Attempting to extract more data than is present!");
+    
+    return scf_buffer_view_wrap(view.data + starting_from, byte_count);
+}
+
+scf_buffer scf_buffer_from_view(scf_operation *operation, scf_buffer_view view) {
+    scf_buffer result = scf_buffer_create(operation, view.size);
+    scf_buffer_append_view(&result, view);
+    return result;
+}
+
+int scf_buffer_view_compare(scf_buffer_view view1, scf_buffer_view view2) {
+    size_t common = view1.size < view2.size ? view1.size : view2.size;
+    int result = common ? memcmp(view1.data, view2.data, common) : 0;
+    if (result == 0 && view1.size != view2.size) {
+        result = view1.size < view2.size ? -1 : 1;
+    }
+    
+    return result;
+}
+
+size_t scf_buffer_view_find(scf_buffer_view view, scf_buffer_view target, size_t starting_from) {
+    if (starting_from > view.size || target.size > view.size - starting_from) return SCF_NOT_FOUND;
+    if (target.size == 0) return starting_from;
+    
+    /*
+     * memchr does the scanning for candidate first bytes, which is
+     * considerably faster than a byte-at-a-time comparison loop.
+     */
+    const unsigned char *current = view.data + starting_from;
+    const unsigned char *last = view.data + view.size - target.size;
+    while (current <= last) {
+        current = memchr(current, target.data[0], last - current + 1);
+        if (!current) break;
+        if (memcmp(current + 1, target.data + 1, target.size - 1) == 0) {
+            return current - view.data;
+        }
+        
+        current++;
+    }
+    
+    return SCF_NOT_FOUND;
+}
+
+extern unsigned char *scf_buffer_data(const scf_buffer *buffer);
+
+extern scf_buffer_view scf_buffer_view_wrap(const void *data, size_t length);
+
+extern scf_buffer_view scf_buffer_get_view(const scf_buffer *buffer);
+
+extern scf_buffer_view scf_buffer_extract_view(const scf_buffer *buffer, size_t starting_from, size_t byte_count);
+
+extern int scf_buffer_compare(const scf_buffer *buf1, const scf_buffer *buf2);
+
+extern size_t scf_buffer_find(const scf_buffer *buffer, scf_buffer_view target, size_t starting_from);
+
+extern void scf_buffer_append_view(scf_buffer *buffer, scf_buffer_view view);
+
 extern void scf_buffer_append(scf_buffer *buf1, const scf_buffer *buf2);
 
 extern void scf_buffer_insert(scf_buffer *buf1, const scf_buffer *buf2, size_t before);
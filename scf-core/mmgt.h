@@ -8,44 +8,467 @@
 #ifndef mmgt_h
 #define mmgt_h
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef void (*scf_exhaustion_handler)(void);
 typedef void (*scf_cleanup_func)(void *);
 
 extern scf_exhaustion_handler exhaustion_handler;
 
+/*
+ * The backend through which all of scf-core's memory is obtained and
+ * released. The context pointer is passed to each function.
+ */
+typedef struct {
+    void *(*alloc)(void *context, size_t size);
+    void *(*realloc)(void *context, void *p, size_t size);
+    void (*free)(void *context, void *p);
+    void *context;
+} scf_allocator;
+
+/*
+ * Call counts kept by a counting allocator. The counts are updated
+ * atomically, so they should only be read once no other thread is
+ * allocating.
+ */
+typedef struct {
+    uint64_t alloc_count;
+    uint64_t realloc_count;
+    uint64_t free_count;
+} scf_allocation_counts;
+
+/*
+ * The default backend, which uses malloc, realloc and free.
+ */
+extern const scf_allocator scf_libc_allocator;
+
+/*-------------------------------------------------------------------
+ * Returns a backend that delegates to the libc backend, counting the
+ * calls made to it in 'counts'.
+ ------------------------------------------------------------------*/
+scf_allocator scf_counting_allocator(scf_allocation_counts *counts);
+
+/*-------------------------------------------------------------------
+ * Installs a process-wide allocator backend (NULL restores the libc
+ * backend). The allocator is copied. Memory must be released through
+ * the backend that provided it, so this should only be called while
+ * no operation holds any memory.
+ *
+ * The mmap path for large allocations is only used with the libc
+ * backend, so that a custom backend sees every allocation.
+ ------------------------------------------------------------------*/
+void scf_set_allocator(const scf_allocator *allocator);
+
+/*
+ * Allocations of at least this many bytes are given their own
+ * anonymous memory mapping (with a transparent huge page hint) where
+ * the platform supports it, and are grown with mremap rather than by
+ * copying. Set to 0 to disable.
+ */
+extern size_t scf_mmap_threshold;
+
+/*-------------------------------------------------------------------
+ * Sampling allocation profiler.
+ *
+ * While profiling, roughly one allocation is sampled for every
+ * 'sample_interval' bytes allocated (including growth by realloc),
+ * and attributed to the calling thread's current stack of tags. The
+ * cost when not sampling is a thread-local countdown, and nothing at
+ * all when profiling is off, so it is suitable for production use
+ * with an interval of, say, 512KB.
+ *
+ * Tags name the subsystem or activity responsible for allocations
+ * and must be string constants (they are compared by address). Each
+ * push must be matched by a pop on the same thread. Consecutive
+ * pushes of the same tag are collapsed, and only the outermost
+ * SCF_PROFILE_MAX_DEPTH tags are recorded. An error handler that
+ * resumes after an error raised in tagged code leaves that code's tags
+ * pushed.
+ *
+ * scf_profile_write writes the estimated bytes allocated under each
+ * tag stack in folded-stack format ("tag;tag;tag bytes" per line), as
+ * consumed by flamegraph.pl and similar tools. Allocations made with
+ * no tags pushed are reported as [untagged]. Starting the profiler
+ * discards any earlier samples; stopping it keeps them for writing.
+ ------------------------------------------------------------------*/
+#define SCF_PROFILE_MAX_DEPTH 8
+
+void scf_profile_start(size_t sample_interval);
+void scf_profile_stop(void);
+void scf_profile_push_tag(const char *tag);
+void scf_profile_pop_tag(void);
+void scf_profile_write(FILE *out);
+
 struct scf_operation;
+struct scf_slab;
+struct scf_registered_cleanup;
 
+/*
+ * Called when an allocation would take an operation over its budget.
+ * Returning true retries the allocation (for instance after raising the
+ * budget); returning false fails it, as set by scf_budget_failure.
+ */
+typedef bool (*scf_budget_handler)(struct scf_operation *operation, size_t required);
+
+/*
+ * How an allocation that exceeds its operation's budget fails.
+ * SCF_BUDGET_RAISE raises SCF_BUDGET_EXCEEDED; SCF_BUDGET_RETURN_NULL
+ * makes the allocating function return NULL.
+ */
+typedef enum {
+    SCF_BUDGET_RAISE,
+    SCF_BUDGET_RETURN_NULL
+} scf_budget_failure;
+
+/*
+ * The header in front of every allocation except the small ones in a
+ * compact operation. It is 48 bytes on a 64-bit platform (up from 24
+ * before blocks carried a back link, their size and flags), which keeps
+ * the data 16-byte aligned; packing the flags into the size word would
+ * save nothing once rounded up to that alignment. Workloads dominated
+ * by tiny allocations should use SCF_COMPACT_OPERATION, whose header is
+ * 8 bytes. The flags word sits immediately before the data in both
+ * kinds of header.
+ */
 typedef struct scf_mem_block {
     struct scf_operation *operation;
     struct scf_mem_block *next;
+    struct scf_mem_block *prev;
     scf_cleanup_func cleanup;
+    size_t size;
+    uint32_t offset;
+    uint32_t flags;
     char data[1];
 } scf_mem_block;
 
+typedef enum {
+    SCF_OP_DEFAULT = 0
+    ,SCF_OP_ARENA
+    ,SCF_OP_CONCURRENT
+    ,SCF_OP_COMPACT
+} scf_operation_mode;
+
+/*
+ * Blocks released with scf_free are kept on per-operation free lists,
+ * one for each power-of-two size class from 16 bytes upwards, so that
+ * later allocations of a similar size can reuse them.
+ */
+#define SCF_SIZE_CLASSES 10
+
+#define SCF_HISTOGRAM_BUCKETS 16
+
+/*
+ * Memory usage statistics for an operation. Sizes are those of the
+ * blocks held, which may exceed the sizes requested when blocks are
+ * recycled. histogram[n] counts allocation requests of up to 16 << n
+ * bytes; the last bucket also counts anything larger.
+ */
+typedef struct {
+    size_t live_bytes;
+    size_t peak_bytes;
+    size_t alloc_count;
+    size_t realloc_count;
+    size_t histogram[SCF_HISTOGRAM_BUCKETS];
+} scf_memory_stats;
+
 typedef struct scf_operation {
     struct scf_mem_block *first;
+    scf_operation_mode mode;
+    struct scf_slab *slabs;
+    struct scf_slab *spare_slabs;
+    struct scf_mem_block *free_blocks[SCF_SIZE_CLASSES];
+    int marks;
+    struct scf_mem_block *last_marker;
+    scf_memory_stats stats;
+    size_t budget;
+    scf_budget_handler budget_handler;
+    scf_budget_failure budget_failure;
+    size_t retention;
+    
+    /*
+     * Compact operations only: the cleanups registered for the
+     * operation's allocations, in the order they were registered, and
+     * an index of them by allocation address.
+     */
+    struct scf_registered_cleanup *cleanups;
+    size_t cleanup_count;
+    size_t cleanup_capacity;
+    size_t *cleanup_index;
+    size_t cleanup_index_capacity;
+    size_t cleanup_index_used;
+    
+    /*
+     * Concurrent operations only. Each thread allocating into the
+     * operation gets its own cache (itself an arena operation whose
+     * parent is this one). The caches are chained through next_cache.
+     * 'caches' and 'id' are shared between threads and are only
+     * accessed atomically, within mmgt.c.
+     *
+     * Each cache accumulates changes to its live bytes in
+     * pending_live_bytes, and adds them to the operation's
+     * shared_live_bytes (atomically) in batches, which is what the
+     * budget is checked against.
+     */
+    struct scf_operation *parent;
+    struct scf_operation *next_cache;
+    struct scf_operation *caches;
+    uint64_t id;
+    uint64_t shared_live_bytes;
+    int64_t pending_live_bytes;
 } scf_operation;
 
 #define SCF_OPERATION(name) scf_operation name = {NULL}
 
+/*-------------------------------------------------------------------
+ * Declares an operation in arena mode. Small allocations are carved
+ * out of large slabs using a bump pointer rather than being
+ * individually malloc'ed, and scf_complete releases the slabs
+ * wholesale. Reallocating the most recent allocation in a slab
+ * grows it in place where there is room.
+ ------------------------------------------------------------------*/
+#define SCF_ARENA_OPERATION(name) scf_operation name = {.mode = SCF_OP_ARENA}
+
+/*-------------------------------------------------------------------
+ * Declares an arena operation that minimises the per-allocation
+ * overhead of tiny allocations. Allocations of up to 256 bytes carry
+ * an 8-byte header instead of a full block header: the owning
+ * operation is found through the slab the allocation lives in, and
+ * cleanups are kept in a registry on the operation. Such allocations
+ * are aligned to 8 bytes rather than 16.
+ *
+ * Memory from a compact allocation released with scf_free is only
+ * reclaimed if it was the most recent allocation in its slab.
+ ------------------------------------------------------------------*/
+#define SCF_COMPACT_OPERATION(name) scf_operation name = {.mode = SCF_OP_COMPACT}
+
+/*-------------------------------------------------------------------
+ * Declares an operation that may be allocated into from several
+ * threads at once without external locking. Each thread allocates
+ * from a thread-local cache belonging to the operation, so no locks
+ * are taken on the allocation path.
+ *
+ * An allocation may only be reallocated or freed by the thread that
+ * made it, and scf_complete must not run concurrently with any other
+ * use of the operation. scf_complete reclaims every thread's cache.
+ ------------------------------------------------------------------*/
+#define SCF_CONCURRENT_OPERATION(name) scf_operation name = {.mode = SCF_OP_CONCURRENT}
+
+/*-------------------------------------------------------------------
+ * A savepoint within an operation, as returned by scf_operation_mark.
+ ------------------------------------------------------------------*/
+typedef void *scf_mark;
+
+/*-------------------------------------------------------------------
+ * The factor by which growable containers (buffers and lists)
+ * multiply their capacity when they run out of room, unless they
+ * have been given a growth factor of their own.
+ ------------------------------------------------------------------*/
+#define SCF_DEFAULT_GROWTH_FACTOR 2.0
+
+/*-------------------------------------------------------------------
+ * The capacity to which a container of the given capacity grows when
+ * it needs room for at least 'required' items: its capacity times the
+ * growth factor (0 meaning SCF_DEFAULT_GROWTH_FACTOR), limited to
+ * 'limit' items, but never less than 'required'. The product is
+ * computed in double precision, so it is exact for any capacity below
+ * 2^53, and saturates rather than overflowing. Raises
+ * SCF_OUT_OF_MEMORY if 'required' exceeds the limit.
+ ------------------------------------------------------------------*/
+size_t scf_grown_capacity(size_t capacity, double growth_factor, size_t required, size_t limit);
+
+/*-------------------------------------------------------------------
+ * Contents of up to this many bytes are held inside the scf_buffer
+ * itself, with no allocation from the operation.
+ ------------------------------------------------------------------*/
+#define SCF_BUFFER_INLINE_CAPACITY 24
+
+/*-------------------------------------------------------------------
+ * A growable run of bytes. Short contents are held inline, in which
+ * case 'data' is NULL; the buffer only allocates from its operation
+ * once it outgrows the inline storage.
+ *
+ * The contents must be reached through scf_buffer_data, and the
+ * buffer's operation through 'operation'. Code written before buffers
+ * held small contents inline, which reads 'data' directly or finds the
+ * operation with scf_get_operation(buffer.data), fails for short
+ * buffers and must be changed accordingly. The layout of the structure
+ * has also changed, so code compiled against the old one must be
+ * rebuilt.
+ ------------------------------------------------------------------*/
 typedef struct {
     size_t size;
     size_t capacity;
     bool pinned;
     unsigned char *data;
+    scf_operation *operation;
+    
+    /*
+     * The factor applied to the capacity when the buffer grows, or 0
+     * for SCF_DEFAULT_GROWTH_FACTOR.
+     */
+    double growth_factor;
+    unsigned char inline_data[SCF_BUFFER_INLINE_CAPACITY];
 } scf_buffer;
 
 void *scf_alloc(scf_operation *operation, size_t required);
 void *scf_alloc_with_cleanup(scf_operation *operation, scf_cleanup_func cleanup, size_t required);
+
+/*-------------------------------------------------------------------
+ * Allocates memory whose address is a multiple of 'alignment', which
+ * must be a power of two. The alignment is preserved by scf_realloc,
+ * and the allocation takes part in operation cleanup as normal.
+ * Ordinary allocations are already aligned to 16 bytes.
+ ------------------------------------------------------------------*/
+void *scf_alloc_aligned(scf_operation *operation, size_t required, size_t alignment);
+void *scf_alloc_aligned_with_cleanup(scf_operation *operation, scf_cleanup_func cleanup, size_t required, size_t alignment);
+
 void *scf_realloc(void *p, size_t required);
+
+/*-------------------------------------------------------------------
+ * Releases an allocation before its operation completes. Any cleanup
+ * registered for it is run immediately. The memory is retained by the
+ * operation and recycled by subsequent allocations of a similar size.
+ ------------------------------------------------------------------*/
+void scf_free(void *p);
+
+/*-------------------------------------------------------------------
+ * Moves an allocation, and its cleanup, into another operation, so
+ * that it lives until that operation completes rather than its own.
+ * This lets a result built in a short-lived scratch operation be kept
+ * without copying it.
+ *
+ * Most allocations are simply re-parented, in constant time, and the
+ * same pointer is returned. Allocations carved from an arena or
+ * compact operation's slabs cannot leave the slab, so they are copied
+ * into the destination and the original is freed (without running
+ * its cleanup); the new pointer is returned.
+ *
+ * A transferred allocation counts toward the destination's budget and
+ * live bytes. If the destination has an outstanding mark, releasing
+ * to that mark releases the allocation.
+ ------------------------------------------------------------------*/
+void *scf_transfer(void *p, scf_operation *dest);
 void scf_complete(scf_operation *operation);
+
+/*-------------------------------------------------------------------
+ * Runs the cleanups for everything allocated in an operation and
+ * makes the operation ready for reuse, as scf_complete does. However,
+ * rather than returning all the memory to the system, up to the
+ * operation's retention limit is kept (as empty slabs and recycled
+ * blocks) to satisfy the next round of allocations.
+ *
+ * The retention limit defaults to 0 and is set with
+ * scf_operation_set_retention. A concurrent operation keeps its
+ * thread caches, each of which retains up to the limit.
+ ------------------------------------------------------------------*/
+void scf_operation_reset(scf_operation *operation);
+void scf_operation_set_retention(scf_operation *operation, size_t bytes);
+
+/*-------------------------------------------------------------------
+ * Records the current state of an operation so that it can later be
+ * rolled back with scf_operation_release_to. Marks may be nested.
+ *
+ * Releasing to a mark runs the cleanups for everything allocated since
+ * the mark (most recent first) and frees that memory; in arena mode
+ * this just resets the bump pointer. Allocations made before the mark
+ * are unaffected, even if they were reallocated after it. Releasing to
+ * a mark also releases any marks taken after it.
+ *
+ * Not supported for concurrent operations.
+ ------------------------------------------------------------------*/
+scf_mark scf_operation_mark(scf_operation *operation);
+void scf_operation_release_to(scf_operation *operation, scf_mark mark);
+
+/*-------------------------------------------------------------------
+ * Returns the memory statistics for an operation. These are
+ * maintained as allocations are made, so this is cheap to call, and
+ * they are reset by scf_complete.
+ *
+ * For a concurrent operation the figures are summed over the thread
+ * caches, so peak_bytes is an upper bound, and the result is only
+ * approximate if other threads are allocating at the time. Releasing
+ * a compact operation to a mark restores live_bytes to its value when
+ * the mark was taken.
+ ------------------------------------------------------------------*/
+scf_memory_stats scf_operation_stats(const scf_operation *operation);
+
+/*-------------------------------------------------------------------
+ * Caps the number of live bytes an operation may hold (0 means no
+ * limit). An allocation, realloc or transfer that would exceed the
+ * budget calls the handler, if any; if there is no handler, or it
+ * declines to retry, the allocation fails as set by
+ * scf_operation_set_budget_failure.
+ *
+ * For a concurrent operation the budget covers all of its threads.
+ * Each thread only publishes its usage in batches of 64KB, so the
+ * budget may be overrun by up to that much per thread, and the handler
+ * may be called from any of the threads.
+ ------------------------------------------------------------------*/
+void scf_operation_set_budget(scf_operation *operation, size_t budget, scf_budget_handler handler);
+
+/*-------------------------------------------------------------------
+ * Sets how allocations fail when they exceed the operation's budget.
+ *
+ * By default (SCF_BUDGET_RAISE) SCF_BUDGET_EXCEEDED is raised through
+ * the installed error handler rather than the exhaustion handler. The
+ * default error handler exits, so this is fatal unless a handler has
+ * been installed that does not return (for instance by longjmp'ing).
+ *
+ * With SCF_BUDGET_RETURN_NULL the failing call returns NULL and
+ * nothing else changes: scf_realloc leaves the original allocation in
+ * place, and scf_transfer leaves it in its original operation. The
+ * containers built on scf_alloc (buffers, lists, dictionaries and so
+ * on) cannot carry on without their memory, so they raise
+ * SCF_BUDGET_EXCEEDED whichever setting is in force, leaving the
+ * container as it was. SCF_BUDGET_RETURN_NULL therefore suits
+ * operations that are allocated into directly.
+ ------------------------------------------------------------------*/
+void scf_operation_set_budget_failure(scf_operation *operation, scf_budget_failure failure);
+
+/*-------------------------------------------------------------------
+ * For containers, on the result of an allocation they cannot do
+ * without: raises SCF_BUDGET_EXCEEDED if it is NULL (as it may be in
+ * an operation with SCF_BUDGET_RETURN_NULL), and otherwise returns it.
+ ------------------------------------------------------------------*/
+void *scf_require_allocation(void *p);
 scf_operation *scf_get_operation(const void *p);
 
+/*-------------------------------------------------------------------
+ * An immutable window onto bytes owned by something else, typically
+ * a buffer. A view holds no storage of its own, so it is only valid
+ * while the bytes it refers to are: it must not outlive its parent's
+ * operation, and a view of a buffer is invalidated by anything that
+ * moves the buffer's contents (growing it, or copying a buffer whose
+ * contents are held inline).
+ ------------------------------------------------------------------*/
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+} scf_buffer_view;
+
+/*-------------------------------------------------------------------
+ * Returned by the search functions when there is no match.
+ ------------------------------------------------------------------*/
+#define SCF_NOT_FOUND SIZE_MAX
+
+/*-------------------------------------------------------------------
+ * Creates an empty buffer in the given operation. If the initial
+ * capacity fits in SCF_BUFFER_INLINE_CAPACITY, nothing is allocated
+ * until the buffer grows beyond that, and until then 'data' is NULL
+ * (see scf_buffer).
+ ------------------------------------------------------------------*/
 scf_buffer scf_buffer_create(scf_operation *operation, size_t initial_capacity);
 
+/*-------------------------------------------------------------------
+ * As scf_buffer_create, but the buffer's data is aligned to the
+ * given power of two, and stays so as the buffer grows. Aligned
+ * buffers never use inline storage.
+ ------------------------------------------------------------------*/
+scf_buffer scf_buffer_create_aligned(scf_operation *operation, size_t initial_capacity, size_t alignment);
+
 /*-------------------------------------------------------------------
  * Wraps an scf_buffer around an existing chunk of memory. The
  * buffer is flagged as 'pinned', meaning that it's data pointer
@@ -54,17 +477,111 @@ scf_buffer scf_buffer_create(scf_operation *operation, size_t initial_capacity);
  ------------------------------------------------------------------*/
 scf_buffer scf_buffer_wrap(void *data, size_t length);
 
+#ifndef WIN32
+/*-------------------------------------------------------------------
+ * Maps a file into memory as a pinned, read-only buffer, so that a
+ * large file can be processed (for example by ucs_encode) without
+ * first being read into memory. The kernel is advised that the file
+ * will be read sequentially. The mapping is released when the
+ * operation completes.
+ *
+ * The buffer must not be written to, and the results are undefined
+ * if the file is truncated while it is mapped. Raises an OS error if
+ * the file cannot be opened or mapped.
+ ------------------------------------------------------------------*/
+scf_buffer scf_buffer_map_file(scf_operation *operation, const char *path);
+#endif
+
+/*-------------------------------------------------------------------
+ * Returns a pointer to the buffer's contents, wherever they are
+ * held. For a buffer using inline storage the pointer is only valid
+ * until the buffer is copied, moved or grown.
+ ------------------------------------------------------------------*/
+inline unsigned char *scf_buffer_data(const scf_buffer *buffer) {
+    return buffer->data ? buffer->data : (unsigned char *)buffer->inline_data;
+}
+
 void scf_buffer_append_bytes(scf_buffer *buffer, const void *bytes_to_append, size_t byte_count);
 void scf_buffer_insert_bytes(scf_buffer *buffer, const void *bytes_to_insert, size_t before, size_t byte_count);
 void scf_buffer_remove(scf_buffer *buffer, size_t starting_from, size_t byte_count);
 scf_buffer scf_buffer_extract(const scf_buffer *buffer, size_t starting_from, size_t byte_count);
 
+/*-------------------------------------------------------------------
+ * Ensures the buffer can hold at least 'capacity' bytes without
+ * further allocation, growing it to exactly that capacity if needed.
+ ------------------------------------------------------------------*/
+void scf_buffer_reserve(scf_buffer *buffer, size_t capacity);
+
+/*-------------------------------------------------------------------
+ * Releases the buffer's unused capacity.
+ ------------------------------------------------------------------*/
+void scf_buffer_shrink_to_fit(scf_buffer *buffer);
+
+/*-------------------------------------------------------------------
+ * Sets the factor by which the buffer's capacity is multiplied when
+ * it grows. The factor must be greater than 1.
+ ------------------------------------------------------------------*/
+void scf_buffer_set_growth_factor(scf_buffer *buffer, double growth_factor);
+
+/*-------------------------------------------------------------------
+ * Moves a buffer's storage into another operation with scf_transfer,
+ * so that the buffer grows in that operation from then on. Pinned
+ * buffers are left alone. Returns the buffer, or NULL (leaving the
+ * buffer unchanged) if the transfer fails under SCF_BUDGET_RETURN_NULL.
+ ------------------------------------------------------------------*/
+scf_buffer *scf_buffer_transfer(scf_buffer *buffer, scf_operation *dest);
+
+/*-------------------------------------------------------------------
+ * Views. Extracting from a view yields another view onto the same
+ * bytes, with no allocation or copying. scf_buffer_from_view copies
+ * a view's bytes into a new buffer when they need to outlive it.
+ ------------------------------------------------------------------*/
+scf_buffer_view scf_buffer_view_extract(scf_buffer_view view, size_t starting_from, size_t byte_count);
+scf_buffer scf_buffer_from_view(scf_operation *operation, scf_buffer_view view);
+
+/*-------------------------------------------------------------------
+ * Compares two views bytewise, as memcmp, with a view that is a
+ * prefix of another ordering before it.
+ ------------------------------------------------------------------*/
+int scf_buffer_view_compare(scf_buffer_view view1, scf_buffer_view view2);
+
+/*-------------------------------------------------------------------
+ * Returns the index of the first occurrence of 'target' in 'view' at
+ * or after 'starting_from', or SCF_NOT_FOUND.
+ ------------------------------------------------------------------*/
+size_t scf_buffer_view_find(scf_buffer_view view, scf_buffer_view target, size_t starting_from);
+
+inline scf_buffer_view scf_buffer_view_wrap(const void *data, size_t length) {
+    scf_buffer_view result = {data, length};
+    return result;
+}
+
+inline scf_buffer_view scf_buffer_get_view(const scf_buffer *buffer) {
+    return scf_buffer_view_wrap(scf_buffer_data(buffer), buffer->size);
+}
+
+inline scf_buffer_view scf_buffer_extract_view(const scf_buffer *buffer, size_t starting_from, size_t byte_count) {
+    return scf_buffer_view_extract(scf_buffer_get_view(buffer), starting_from, byte_count);
+}
+
+inline int scf_buffer_compare(const scf_buffer *buf1, const scf_buffer *buf2) {
+    return scf_buffer_view_compare(scf_buffer_get_view(buf1), scf_buffer_get_view(buf2));
+}
+
+inline size_t scf_buffer_find(const scf_buffer *buffer, scf_buffer_view target, size_t starting_from) {
+    return scf_buffer_view_find(scf_buffer_get_view(buffer), target, starting_from);
+}
+
+inline void scf_buffer_append_view(scf_buffer *buffer, scf_buffer_view view) {
+    scf_buffer_append_bytes(buffer, view.data, view.size);
+}
+
 inline void scf_buffer_append(scf_buffer *buf1, const scf_buffer *buf2) {
-    scf_buffer_append_bytes(buf1, buf2->data, buf2->size);
+    scf_buffer_append_bytes(buf1, scf_buffer_data(buf2), buf2->size);
 }
 
 inline void scf_buffer_insert(scf_buffer *buf1, const scf_buffer *buf2, size_t before) {
-    scf_buffer_insert_bytes(buf1, buf2->data, before, buf2->size);
+    scf_buffer_insert_bytes(buf1, scf_buffer_data(buf2), before, buf2->size);
 }
 
 inline void scf_buffer_append_byte(scf_buffer *buf, unsigned char byte) {
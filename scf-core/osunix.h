@@ -9,7 +9,25 @@
 #define osunix_h
 
 #define SCF_EXTERNAL
+#define SCF_THREAD_LOCAL _Thread_local
 
 typedef int scf_os_error_code;
 
+/*
+ * Sequentially consistent atomic operations on ordinary 64-bit integers
+ * and pointers, so that data shared between threads can be declared in
+ * public headers without C11 atomic types. The compare-and-swap
+ * functions store the current value in *expected when they fail.
+ */
+#define scf_atomic_load_u64(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define scf_atomic_store_u64(p, value) __atomic_store_n((p), (value), __ATOMIC_SEQ_CST)
+#define scf_atomic_add_u64(p, n) __atomic_fetch_add((p), (n), __ATOMIC_SEQ_CST)
+#define scf_atomic_cas_u64(p, expected, desired) \
+    __atomic_compare_exchange_n((p), (expected), (desired), 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+
+#define scf_atomic_load_ptr(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define scf_atomic_exchange_ptr(p, value) __atomic_exchange_n((p), (value), __ATOMIC_SEQ_CST)
+#define scf_atomic_cas_ptr(p, expected, desired) \
+    __atomic_compare_exchange_n((p), (expected), (desired), 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+
 #endif /* osunix_h */
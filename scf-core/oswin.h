@@ -8,11 +8,47 @@
 #ifndef oswin_h
 #define oswin_h
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <Windows.h>
 
 #define SCF_EXTERNAL __stdcall
+#define SCF_THREAD_LOCAL __declspec(thread)
 
 typedef DWORD scf_os_error_code;
 typedef PLARGE_INTEGER scf_file_size;
 
+/*
+ * Sequentially consistent atomic operations on ordinary 64-bit integers
+ * and pointers, so that data shared between threads can be declared in
+ * public headers without C11 atomic types. The compare-and-swap
+ * functions store the current value in *expected when they fail.
+ */
+#define scf_atomic_load_u64(p) ((uint64_t)InterlockedCompareExchange64((volatile LONG64 *)(p), 0, 0))
+#define scf_atomic_store_u64(p, value) ((void)InterlockedExchange64((volatile LONG64 *)(p), (LONG64)(value)))
+#define scf_atomic_add_u64(p, n) ((uint64_t)InterlockedExchangeAdd64((volatile LONG64 *)(p), (LONG64)(n)))
+
+static inline bool scf_atomic_cas_u64(uint64_t *p, uint64_t *expected, uint64_t desired) {
+    uint64_t current = (uint64_t)InterlockedCompareExchange64((volatile LONG64 *)p, (LONG64)desired, (LONG64)*expected);
+    if (current == *expected) return true;
+    
+    *expected = current;
+    return false;
+}
+
+#define scf_atomic_load_ptr(p) InterlockedCompareExchangePointer((PVOID volatile *)(p), NULL, NULL)
+#define scf_atomic_exchange_ptr(p, value) InterlockedExchangePointer((PVOID volatile *)(p), (value))
+
+/*
+ * 'p' and 'expected' point to pointers of the same (any) type.
+ */
+static inline bool scf_atomic_cas_ptr(void *p, void *expected, void *desired) {
+    PVOID *expected_value = expected;
+    PVOID current = InterlockedCompareExchangePointer((PVOID volatile *)p, desired, *expected_value);
+    if (current == *expected_value) return true;
+    
+    *expected_value = current;
+    return false;
+}
+
 #endif /* oswin_h */
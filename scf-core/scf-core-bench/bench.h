@@ -0,0 +1,21 @@
+//
+//  bench.h
+//  scf-core-bench
+//
+
+#ifndef bench_h
+#define bench_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+#define BENCH_HEADING(name) printf("\n%s\n", (name))
+
+#endif /* bench_h */
@@ -0,0 +1,272 @@
+//
+//  hash_bench.c
+//  scf-core-bench
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "hash.h"
+#include "typed_hash.h"
+
+#define LIVE_KEYS (1 << 20)
+#define CHURN_ROUNDS (1 << 21)
+#define TYPED_KEYS (1 << 20)
+#define STRING_KEYS (1 << 18)
+#define GROWTH_KEYS (1 << 22)
+
+static size_t int_hash(scf_datum key) {
+    return scf_hash_uint64((uint64_t)key.i_value);
+}
+
+static size_t identity_int_hash(scf_datum key) {
+    return (size_t)key.i_value;
+}
+
+static bool int_equal(scf_datum k1, scf_datum k2) {
+    return k1.type == k2.type && k1.i_value == k2.i_value;
+}
+
+static size_t typed_int_hash(int64_t key) {
+    return scf_hash_uint64((uint64_t)key);
+}
+
+SCF_DEFINE_MAP(bench_int_map, int64_t, int64_t, typed_int_hash, SCF_VALUE_EQUAL)
+
+static int compare_latencies(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Holds the dictionary at LIVE_KEYS entries while repeatedly removing
+ * the oldest key and adding a new one, timing a lookup of a random
+ * live key (and of a missing key) after each step. Tombstones or
+ * ever-growing probe limits would show up as a rising tail.
+ */
+static void churn_lookup_latency(scf_dictionary_layout layout, const char *heading) {
+    BENCH_HEADING(heading);
+    printf("%12s %10s %10s %10s %16s\n", "rounds", "p50 ns", "p99 ns", "miss p99", "max collisions");
+    
+    SCF_OPERATION(op);
+    scf_dictionary d = scf_dictionary_create_with_layout(&op, int_hash, int_equal, 0, layout);
+    for (int i = 0; i < LIVE_KEYS; i++) {
+        scf_dictionary_add(&d, dt_int(i), dt_int(i));
+    }
+    
+    const int report_every = CHURN_ROUNDS / 4;
+    uint32_t *hits = scf_alloc(&op, report_every * sizeof(uint32_t));
+    uint32_t *misses = scf_alloc(&op, report_every * sizeof(uint32_t));
+    srand(1);
+    for (int round = 0; round < CHURN_ROUNDS; round++) {
+        int newest = LIVE_KEYS + round;
+        scf_dictionary_remove(&d, dt_int(round));
+        scf_dictionary_add(&d, dt_int(newest), dt_int(newest));
+        
+        int key = round + 1 + rand() % LIVE_KEYS;
+        uint64_t start = bench_now_ns();
+        scf_dictionary_lookup(&d, dt_int(key));
+        uint64_t middle = bench_now_ns();
+        scf_dictionary_lookup(&d, dt_int(-key));
+        uint64_t end = bench_now_ns();
+        hits[round % report_every] = (uint32_t)(middle - start);
+        misses[round % report_every] = (uint32_t)(end - middle);
+        
+        if ((round + 1) % report_every == 0) {
+            qsort(hits, report_every, sizeof(uint32_t), compare_latencies);
+            qsort(misses, report_every, sizeof(uint32_t), compare_latencies);
+            printf("%12d %10u %10u %10u %16d\n", round + 1,
+                   hits[report_every / 2], hits[report_every / 100 * 99], misses[report_every / 100 * 99], d.max_collisions);
+        }
+    }
+    
+    scf_complete(&op);
+}
+
+static void print_typed_row(const char *target, uint64_t add, uint64_t hit, uint64_t miss) {
+    printf("%16s %10.1f %10.1f %10.1f\n", target,
+           (double)add / TYPED_KEYS, (double)hit / TYPED_KEYS, (double)miss / TYPED_KEYS);
+}
+
+/*
+ * Compares an int64 -> int64 map generated by SCF_DEFINE_MAP with
+ * scf_dictionary holding the same keys as scf_datums.
+ */
+static void typed_vs_generic(void) {
+    BENCH_HEADING("Typed map vs scf_dictionary, 1M int keys (ns per operation)");
+    printf("%16s %10s %10s %10s\n", "target", "add", "hit", "miss");
+    int64_t checksum = 0;
+    
+    SCF_OPERATION(typed_op);
+    bench_int_map map = bench_int_map_create(&typed_op, 0);
+    uint64_t start = bench_now_ns();
+    for (int64_t i = 0; i < TYPED_KEYS; i++) {
+        bench_int_map_add(&map, i, i);
+    }
+    
+    uint64_t added = bench_now_ns();
+    for (int64_t i = 0; i < TYPED_KEYS; i++) {
+        checksum += *bench_int_map_lookup(&map, i);
+    }
+    
+    uint64_t hit = bench_now_ns();
+    for (int64_t i = 0; i < TYPED_KEYS; i++) {
+        checksum += bench_int_map_lookup(&map, -1 - i) != NULL;
+    }
+    
+    print_typed_row("typed map", added - start, hit - added, bench_now_ns() - hit);
+    scf_complete(&typed_op);
+    
+    for (int layout = SCF_DICTIONARY_ROBIN_HOOD; layout <= SCF_DICTIONARY_SWISS; layout++) {
+        SCF_OPERATION(op);
+        scf_dictionary d = scf_dictionary_create_with_layout(&op, int_hash, int_equal, 0, layout);
+        start = bench_now_ns();
+        for (int64_t i = 0; i < TYPED_KEYS; i++) {
+            scf_dictionary_add(&d, dt_int(i), dt_int(i));
+        }
+        
+        added = bench_now_ns();
+        for (int64_t i = 0; i < TYPED_KEYS; i++) {
+            checksum += scf_dictionary_lookup(&d, dt_int(i))->i_value;
+        }
+        
+        hit = bench_now_ns();
+        for (int64_t i = 0; i < TYPED_KEYS; i++) {
+            checksum += scf_dictionary_lookup(&d, dt_int(-1 - i)) != NULL;
+        }
+        
+        print_typed_row(layout == SCF_DICTIONARY_SWISS ? "swiss dict" : "robin hood dict", added - start, hit - added, bench_now_ns() - hit);
+        scf_complete(&op);
+    }
+    
+    if (checksum == 0) printf("(checksum %lld)\n", (long long)checksum);
+}
+
+static size_t string_hash(scf_datum key) {
+    size_t h = 5381;
+    for (const char *s = key.p_value; *s; s++) {
+        h = h * 33 + (unsigned char)*s;
+    }
+    
+    return h;
+}
+
+static bool string_equal(scf_datum k1, scf_datum k2) {
+    return strcmp(k1.p_value, k2.p_value) == 0;
+}
+
+/*
+ * Sequential int keys under the identity hash, whose high bits are
+ * all zero, to show whether each layout copes with a weak hash.
+ */
+static void weak_hash(void) {
+    BENCH_HEADING("Identity hash on 1M sequential int keys (ns per operation)");
+    printf("%16s %10s %10s %10s %16s\n", "layout", "add", "hit", "miss", "max collisions");
+    int64_t checksum = 0;
+    for (int layout = SCF_DICTIONARY_ROBIN_HOOD; layout <= SCF_DICTIONARY_SWISS; layout++) {
+        SCF_OPERATION(op);
+        scf_dictionary d = scf_dictionary_create_with_layout(&op, identity_int_hash, int_equal, 0, layout);
+        uint64_t start = bench_now_ns();
+        for (int64_t i = 0; i < TYPED_KEYS; i++) {
+            scf_dictionary_add(&d, dt_int(i), dt_int(i));
+        }
+        
+        uint64_t added = bench_now_ns();
+        for (int64_t i = 0; i < TYPED_KEYS; i++) {
+            checksum += scf_dictionary_lookup(&d, dt_int(i))->i_value;
+        }
+        
+        uint64_t hit = bench_now_ns();
+        for (int64_t i = 0; i < TYPED_KEYS; i++) {
+            checksum += scf_dictionary_lookup(&d, dt_int(TYPED_KEYS + i)) != NULL;
+        }
+        
+        uint64_t end = bench_now_ns();
+        printf("%16s %10.1f %10.1f %10.1f %16d\n", layout == SCF_DICTIONARY_SWISS ? "swiss" : "robin hood",
+               (double)(added - start) / TYPED_KEYS, (double)(hit - added) / TYPED_KEYS, (double)(end - hit) / TYPED_KEYS, d.max_collisions);
+        scf_complete(&op);
+    }
+    
+    if (checksum == 0) printf("(checksum %lld)\n", (long long)checksum);
+}
+
+/*
+ * Measures adding string keys (which includes every resize) and
+ * looking up missing ones, with and without stored hashes.
+ */
+static void stored_hashes(void) {
+    BENCH_HEADING("String keys with and without stored hashes (ns per operation)");
+    printf("%16s %10s %10s %10s\n", "target", "layout", "add", "miss");
+    
+    SCF_OPERATION(keys_op);
+    char *keys = scf_alloc(&keys_op, 2 * STRING_KEYS * 32);
+    for (int i = 0; i < 2 * STRING_KEYS; i++) {
+        snprintf(keys + i * 32, 32, "a fairly long string key %d", i);
+    }
+    
+    for (int layout = SCF_DICTIONARY_ROBIN_HOOD; layout <= SCF_DICTIONARY_SWISS; layout++) {
+        for (int store = 0; store <= 1; store++) {
+            SCF_OPERATION(op);
+            scf_dictionary_options options = {layout, store, false};
+            scf_dictionary d = scf_dictionary_create_with_options(&op, string_hash, string_equal, 0, options);
+            uint64_t start = bench_now_ns();
+            for (int i = 0; i < STRING_KEYS; i++) {
+                scf_datum key = {DT_PTR, .p_value = keys + i * 32};
+                scf_dictionary_add(&d, key, dt_int(i));
+            }
+            
+            uint64_t added = bench_now_ns();
+            for (int i = STRING_KEYS; i < 2 * STRING_KEYS; i++) {
+                scf_datum key = {DT_PTR, .p_value = keys + i * 32};
+                scf_dictionary_lookup(&d, key);
+            }
+            
+            printf("%16s %10s %10.1f %10.1f\n", store ? "stored hashes" : "no stored hashes",
+                   layout == SCF_DICTIONARY_SWISS ? "swiss" : "robin hood",
+                   (double)(added - start) / STRING_KEYS, (double)(bench_now_ns() - added) / STRING_KEYS);
+            scf_complete(&op);
+        }
+    }
+    
+    scf_complete(&keys_op);
+}
+
+/*
+ * Measures the slowest single add while growing a dictionary from
+ * empty, with and without incremental rehashing.
+ */
+static void add_tail_latency(void) {
+    BENCH_HEADING("Slowest add while growing to 4M int keys");
+    printf("%16s %10s %12s %12s\n", "target", "layout", "total ms", "max add us");
+    for (int layout = SCF_DICTIONARY_ROBIN_HOOD; layout <= SCF_DICTIONARY_SWISS; layout++) {
+        for (int incremental = 0; incremental <= 1; incremental++) {
+            SCF_OPERATION(op);
+            scf_dictionary_options options = {layout, false, incremental};
+            scf_dictionary d = scf_dictionary_create_with_options(&op, int_hash, int_equal, 0, options);
+            uint64_t slowest = 0;
+            uint64_t start = bench_now_ns();
+            for (int i = 0; i < GROWTH_KEYS; i++) {
+                uint64_t before = bench_now_ns();
+                scf_dictionary_add(&d, dt_int(i), dt_int(i));
+                uint64_t elapsed = bench_now_ns() - before;
+                if (elapsed > slowest) slowest = elapsed;
+            }
+            
+            printf("%16s %10s %12.1f %12.1f\n", incremental ? "incremental" : "all at once",
+                   layout == SCF_DICTIONARY_SWISS ? "swiss" : "robin hood",
+                   (bench_now_ns() - start) / 1e6, slowest / 1e3);
+            scf_complete(&op);
+        }
+    }
+}
+
+void hash_bench(void) {
+    churn_lookup_latency(SCF_DICTIONARY_ROBIN_HOOD, "Robin Hood scf_dictionary lookup latency under insert/remove churn");
+    churn_lookup_latency(SCF_DICTIONARY_SWISS, "Swiss table scf_dictionary lookup latency under insert/remove churn");
+    typed_vs_generic();
+    weak_hash();
+    stored_hashes();
+    add_tail_latency();
+}
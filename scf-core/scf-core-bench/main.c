@@ -0,0 +1,15 @@
+//
+//  main.c
+//  scf-core-bench
+//
+
+#include <stdio.h>
+
+void mmgt_bench(void);
+void hash_bench(void);
+
+int main(int argc, const char * argv[]) {
+    mmgt_bench();
+    hash_bench();
+    return 0;
+}
@@ -0,0 +1,73 @@
+//
+//  mmgt_bench.c
+//  scf-core-bench
+//
+
+#include <stdio.h>
+#include "bench.h"
+#include "mmgt.h"
+#include "chain.h"
+
+#define REALLOC_COUNT 10000
+#define APPEND_TOTAL ((size_t)256 * 1024 * 1024)
+
+/*
+ * Measures the cost of growing the oldest block in an operation (the
+ * one furthest from the head of the block list) as the number of live
+ * blocks in the operation increases.
+ */
+static void realloc_vs_live_blocks(void) {
+    BENCH_HEADING("scf_realloc of oldest block vs live block count");
+    printf("%12s %16s\n", "live blocks", "ns per realloc");
+    for (size_t live_blocks = 1000; live_blocks <= 1000000; live_blocks *= 10) {
+        SCF_OPERATION(op);
+        void *oldest = scf_alloc(&op, 16);
+        for (size_t i = 1; i < live_blocks; i++) {
+            scf_alloc(&op, 16);
+        }
+        
+        uint64_t start = bench_now_ns();
+        for (int i = 0; i < REALLOC_COUNT; i++) {
+            oldest = scf_realloc(oldest, 16 + (i & 1) * 16);
+        }
+        
+        uint64_t elapsed = bench_now_ns() - start;
+        printf("%12zu %16.1f\n", live_blocks, (double)elapsed / REALLOC_COUNT);
+        scf_complete(&op);
+    }
+}
+
+/*
+ * Compares building a large output by appending to a buffer, which
+ * doubles and copies as it grows, with appending to a chain.
+ */
+static void buffer_vs_chain_append(void) {
+    static char piece[4096];
+    BENCH_HEADING("Appending 256MB in 4KB pieces");
+    printf("%12s %16s\n", "target", "ms");
+    
+    SCF_OPERATION(buffer_op);
+    scf_buffer buffer = scf_buffer_create(&buffer_op, 0);
+    uint64_t start = bench_now_ns();
+    for (size_t n = 0; n < APPEND_TOTAL; n += sizeof(piece)) {
+        scf_buffer_append_bytes(&buffer, piece, sizeof(piece));
+    }
+    
+    printf("%12s %16.1f\n", "buffer", (bench_now_ns() - start) / 1e6);
+    scf_complete(&buffer_op);
+    
+    SCF_OPERATION(chain_op);
+    scf_chain chain = scf_chain_create(&chain_op, 0);
+    start = bench_now_ns();
+    for (size_t n = 0; n < APPEND_TOTAL; n += sizeof(piece)) {
+        scf_chain_append_bytes(&chain, piece, sizeof(piece));
+    }
+    
+    printf("%12s %16.1f\n", "chain", (bench_now_ns() - start) / 1e6);
+    scf_complete(&chain_op);
+}
+
+void mmgt_bench(void) {
+    realloc_vs_live_blocks();
+    buffer_vs_chain_append();
+}
@@ -7,6 +7,10 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
 #include "mmgt.h"
 #include "scuts.h"
 
@@ -22,30 +26,59 @@ void buffer_tests_cleanup(void) {
 
 bool test_buffer_append_bytes(void) {
     scf_buffer buf = scf_buffer_create(&op, 1);
-    bool result = ASSERT_EQ(4, buf.capacity);
+    bool result = ASSERT_EQ(SCF_BUFFER_INLINE_CAPACITY, buf.capacity);
     scf_buffer_append_bytes(&buf, "abc", 3);
     scf_buffer_append_bytes(&buf, "123", 4);
-    result &= ASSERT_EQ(8, buf.capacity);
+    result &= ASSERT_EQ(SCF_BUFFER_INLINE_CAPACITY, buf.capacity);
     result &= ASSERT_EQ(7, buf.size);
-    result &= ASSERT_EQ(0, strcmp("abc123", (char *)buf.data));
+    result &= ASSERT_EQ(0, strcmp("abc123", (char *)scf_buffer_data(&buf)));
     return result;
 }
 
+bool test_buffer_inline_storage(void) {
+    scf_buffer buf = scf_buffer_create(&op, 0);
+    scf_buffer_append_bytes(&buf, "0123456789", 10);
+    scf_buffer_append_bytes(&buf, "0123456789", 10);
+    bool result = ASSERT_TRUE(buf.data == NULL)
+        && ASSERT_TRUE(scf_buffer_data(&buf) == buf.inline_data);
+    
+    scf_buffer copy = buf;
+    result &= ASSERT_EQ(0, memcmp("01234567890123456789", scf_buffer_data(&copy), 20));
+    
+    scf_buffer_append_bytes(&buf, "0123456789", 10);
+    result &= ASSERT_TRUE(buf.data != NULL)
+        && ASSERT_TRUE(scf_get_operation(buf.data) == &op)
+        && ASSERT_EQ(2 * SCF_BUFFER_INLINE_CAPACITY, buf.capacity)
+        && ASSERT_EQ(30, buf.size)
+        && ASSERT_EQ(0, memcmp("012345678901234567890123456789", scf_buffer_data(&buf), 30));
+    
+    scf_buffer large = scf_buffer_create(&op, 100);
+    return result && ASSERT_TRUE(large.data != NULL) && ASSERT_EQ(100, large.capacity);
+}
+
+bool test_buffer_wrap(void) {
+    char bytes[] = "abc";
+    scf_buffer buf = scf_buffer_wrap(bytes, 3);
+    return ASSERT_TRUE(buf.pinned)
+        && ASSERT_TRUE(scf_buffer_data(&buf) == (unsigned char *)bytes)
+        && ASSERT_EQ(3, buf.size);
+}
+
 bool test_buffer_insert_bytes(void) {
     scf_buffer buf = scf_buffer_create(&op, 1);
     scf_buffer_append_bytes(&buf, "abc", 3);
     scf_buffer_insert_bytes(&buf, "", 2, 0);
     bool result = true;
     result &= ASSERT_EQ(3, buf.size);
-    result &= ASSERT_EQ(0, memcmp("abc123", (char *)buf.data, buf.size));
+    result &= ASSERT_EQ(0, memcmp("abc123", (char *)scf_buffer_data(&buf), buf.size));
     
     scf_buffer_insert_bytes(&buf, "12", 3, 2);
     result &= ASSERT_EQ(5, buf.size);
-    result &= ASSERT_EQ(0, memcmp("abc12", (char *)buf.data, buf.size));
+    result &= ASSERT_EQ(0, memcmp("abc12", (char *)scf_buffer_data(&buf), buf.size));
     
     scf_buffer_insert_bytes(&buf, "3456", 3, 4);
     result &= ASSERT_EQ(9, buf.size);
-    result &= ASSERT_EQ(0, memcmp("abc345612", (char *)buf.data, buf.size));
+    result &= ASSERT_EQ(0, memcmp("abc345612", (char *)scf_buffer_data(&buf), buf.size));
     return result;
 }
 
@@ -55,7 +88,7 @@ bool test_buffer_remove(void) {
     scf_buffer_remove(&buf, 2, 3);
     bool result = true;
     result &= ASSERT_EQ(3, buf.size);
-    result &= ASSERT_EQ(0, memcmp("126", (char *)buf.data, buf.size));
+    result &= ASSERT_EQ(0, memcmp("126", (char *)scf_buffer_data(&buf), buf.size));
     return result;
 }
 
@@ -68,7 +101,130 @@ bool test_buffer_extract(void) {
 
     buf2 = scf_buffer_extract(&buf, 1, 3);
     result &= ASSERT_EQ(3, buf2.size);
-    result &= ASSERT_EQ(0, memcmp("234", (char *)buf2.data, buf2.size));
+    result &= ASSERT_EQ(0, memcmp("234", (char *)scf_buffer_data(&buf2), buf2.size));
+    return result;
+}
+
+bool test_buffer_reserve_and_shrink(void) {
+    scf_buffer buf = scf_buffer_create(&op, 0);
+    scf_buffer_append_bytes(&buf, "abc", 3);
+    scf_buffer_reserve(&buf, 1000);
+    bool result = ASSERT_EQ(1000, buf.capacity)
+        && ASSERT_EQ(0, memcmp("abc", scf_buffer_data(&buf), 3));
+    
+    for (int i = 0; i < 99; i++) {
+        scf_buffer_append_bytes(&buf, "0123456789", 10);
+    }
+    
+    result &= ASSERT_EQ(1000, buf.capacity);
+    scf_buffer_remove(&buf, 0, 493);
+    scf_buffer_shrink_to_fit(&buf);
+    return result
+        && ASSERT_EQ(500, buf.capacity)
+        && ASSERT_EQ(0, memcmp("0123456789", scf_buffer_data(&buf) + 490, 10));
+}
+
+bool test_buffer_growth_factor(void) {
+    scf_buffer buf = scf_buffer_create(&op, 100);
+    scf_buffer_set_growth_factor(&buf, 1.25f);
+    for (int i = 0; i < 11; i++) {
+        scf_buffer_append_bytes(&buf, "0123456789", 10);
+    }
+    
+    return ASSERT_EQ(125, buf.capacity) && ASSERT_EQ(110, buf.size);
+}
+
+bool test_grown_capacity(void) {
+    size_t capacity = ((size_t)1 << 25) + 1;
+    return ASSERT_EQ(capacity + capacity / 2, scf_grown_capacity(capacity, 1.5, capacity + 1, SIZE_MAX))
+        && ASSERT_EQ(2 * capacity, scf_grown_capacity(capacity, 0, capacity + 1, SIZE_MAX))
+        && ASSERT_EQ(1000, scf_grown_capacity(10, 2.0, 1000, SIZE_MAX))
+        && ASSERT_TRUE(scf_grown_capacity(SIZE_MAX / 2 + 1, 2.0, SIZE_MAX / 2 + 2, SIZE_MAX) == SIZE_MAX)
+        && ASSERT_TRUE(scf_grown_capacity(SIZE_MAX / 32, 4.0, SIZE_MAX / 32 + 1, SIZE_MAX / 16) == SIZE_MAX / 16);
+}
+
+bool test_buffer_views(void) {
+    scf_buffer buf = scf_buffer_create(&op, 100);
+    scf_buffer_append_bytes(&buf, "name=value;other=thing", 22);
+    scf_buffer_view field = scf_buffer_extract_view(&buf, 5, 5);
+    scf_buffer_view key = scf_buffer_view_extract(scf_buffer_get_view(&buf), 11, 5);
+    bool result = ASSERT_TRUE(field.data == scf_buffer_data(&buf) + 5)
+        && ASSERT_EQ(0, scf_buffer_view_compare(field, scf_buffer_view_wrap("value", 5)))
+        && ASSERT_EQ(0, scf_buffer_view_compare(key, scf_buffer_view_wrap("other", 5)));
+    
+    result &= ASSERT_TRUE(scf_buffer_view_compare(field, scf_buffer_view_wrap("valued", 6)) < 0)
+        && ASSERT_TRUE(scf_buffer_view_compare(field, scf_buffer_view_wrap("val", 3)) > 0)
+        && ASSERT_TRUE(scf_buffer_view_compare(field, key) > 0);
+    
+    scf_buffer copy = scf_buffer_from_view(&op, field);
+    result &= ASSERT_EQ(5, copy.size) && ASSERT_EQ(0, memcmp("value", scf_buffer_data(&copy), 5));
+    return result;
+}
+
+bool test_buffer_find(void) {
+    scf_buffer buf = scf_buffer_create(&op, 0);
+    scf_buffer_append_bytes(&buf, "abcabcabd", 9);
+    bool result = ASSERT_EQ(0, scf_buffer_find(&buf, scf_buffer_view_wrap("abc", 3), 0))
+        && ASSERT_EQ(3, scf_buffer_find(&buf, scf_buffer_view_wrap("abc", 3), 1))
+        && ASSERT_EQ(6, scf_buffer_find(&buf, scf_buffer_view_wrap("abd", 3), 0))
+        && ASSERT_EQ(SCF_NOT_FOUND, scf_buffer_find(&buf, scf_buffer_view_wrap("abe", 3), 0))
+        && ASSERT_EQ(SCF_NOT_FOUND, scf_buffer_find(&buf, scf_buffer_view_wrap("abd", 3), 7))
+        && ASSERT_EQ(4, scf_buffer_find(&buf, scf_buffer_view_wrap("", 0), 4));
+    
+    scf_buffer other = scf_buffer_create(&op, 0);
+    scf_buffer_append_bytes(&other, "abcabcabd", 9);
+    return result && ASSERT_EQ(0, scf_buffer_compare(&buf, &other));
+}
+
+bool test_buffer_transfer(void) {
+    SCF_OPERATION(scratch);
+    scf_buffer buf = scf_buffer_create(&scratch, 0);
+    for (int i = 0; i < 10; i++) {
+        scf_buffer_append_bytes(&buf, "0123456789", 10);
+    }
+    
+    unsigned char *data = buf.data;
+    scf_buffer_transfer(&buf, &op);
+    scf_complete(&scratch);
+    scf_buffer_append_bytes(&buf, "0123456789", 10);
+    return ASSERT_TRUE(buf.operation == &op)
+        && ASSERT_EQ(110, buf.size)
+        && ASSERT_TRUE(data != NULL)
+        && ASSERT_EQ(0, memcmp("0123456789", scf_buffer_data(&buf) + 100, 10));
+}
+
+#ifndef WIN32
+bool test_buffer_map_file(void) {
+    char path[] = "/tmp/scf_map_testXXXXXX";
+    int fd = mkstemp(path);
+    for (int i = 0; i < 1000; i++) {
+        write(fd, "0123456789", 10);
+    }
+    
+    close(fd);
+    SCF_OPERATION(map_op);
+    scf_buffer buf = scf_buffer_map_file(&map_op, path);
+    bool result = ASSERT_TRUE(buf.pinned)
+        && ASSERT_EQ(10000, buf.size)
+        && ASSERT_EQ(0, memcmp("0123456789", scf_buffer_data(&buf) + 9990, 10))
+        && ASSERT_EQ(1000, scf_buffer_find(&buf, scf_buffer_view_wrap("0123", 4), 999));
+    
+    scf_complete(&map_op);
+    unlink(path);
+    return result;
+}
+#endif
+
+bool test_buffer_create_aligned(void) {
+    scf_buffer buf = scf_buffer_create_aligned(&op, 1, 64);
+    bool result = ASSERT_TRUE(((uintptr_t)scf_buffer_data(&buf) & 63) == 0);
+    for (int i = 0; i < 100; i++) {
+        scf_buffer_append_bytes(&buf, "0123456789", 10);
+    }
+    
+    result &= ASSERT_TRUE(((uintptr_t)scf_buffer_data(&buf) & 63) == 0)
+        && ASSERT_EQ(1000, buf.size)
+        && ASSERT_EQ(0, memcmp("0123456789", scf_buffer_data(&buf) + 990, 10));
     return result;
 }
 
@@ -76,8 +232,20 @@ BEGIN_TEST_GROUP(buffer_tests)
     INIT(buffer_tests_init)
     CLEANUP(buffer_tests_cleanup)
     TEST(test_buffer_append_bytes)
+    TEST(test_buffer_inline_storage)
+    TEST(test_buffer_wrap)
     TEST(test_buffer_insert_bytes)
     TEST(test_buffer_remove)
     TEST(test_buffer_extract)
+    TEST(test_buffer_reserve_and_shrink)
+    TEST(test_buffer_growth_factor)
+    TEST(test_grown_capacity)
+    TEST(test_buffer_views)
+    TEST(test_buffer_find)
+    TEST(test_buffer_create_aligned)
+    TEST(test_buffer_transfer)
+#ifndef WIN32
+    TEST(test_buffer_map_file)
+#endif
 END_TEST_GROUP
 
@@ -0,0 +1,121 @@
+//
+//  chain_tests.c
+//  ScafellTest
+//
+
+#include <stdio.h>
+#include <string.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+#include "scuts.h"
+#include "chain.h"
+
+#define CHUNK_SIZE 64
+
+static SCF_OPERATION(op);
+static scf_chain chain;
+static char expected[1000];
+
+void chain_tests_init(void) {
+    chain = scf_chain_create(&op, CHUNK_SIZE);
+    for (size_t i = 0; i < sizeof(expected); i++) {
+        expected[i] = 'a' + i % 26;
+    }
+}
+
+void chain_tests_cleanup(void) {
+    scf_complete(&op);
+}
+
+bool test_chain_append(void) {
+    scf_chain_append_bytes(&chain, expected, 10);
+    scf_chain_append_bytes(&chain, expected + 10, sizeof(expected) - 10);
+    
+    size_t total = 0;
+    size_t segments = 0;
+    bool result = true;
+    scf_buffer_view segment;
+    scf_chain_iterator iter = scf_chain_get_iterator(&chain);
+    while (scf_chain_next(&iter, &segment)) {
+        result &= ASSERT_TRUE(segment.size <= CHUNK_SIZE)
+            && ASSERT_EQ(0, memcmp(expected + total, segment.data, segment.size));
+        total += segment.size;
+        segments++;
+    }
+    
+    return result
+        && ASSERT_EQ(sizeof(expected), chain.size)
+        && ASSERT_EQ(sizeof(expected), total)
+        && ASSERT_TRUE(segments > sizeof(expected) / CHUNK_SIZE);
+}
+
+bool test_chain_flatten(void) {
+    scf_chain_append_bytes(&chain, expected, sizeof(expected));
+    scf_buffer flat = scf_chain_flatten(&chain);
+    return ASSERT_EQ(sizeof(expected), flat.size)
+        && ASSERT_EQ(0, memcmp(expected, scf_buffer_data(&flat), flat.size));
+}
+
+bool test_chain_truncate(void) {
+    scf_chain_append_bytes(&chain, expected, sizeof(expected));
+    scf_chain_truncate(&chain, 100);
+    scf_chain_append_bytes(&chain, "xyz", 3);
+    scf_buffer flat = scf_chain_flatten(&chain);
+    bool result = ASSERT_EQ(103, chain.size)
+        && ASSERT_EQ(0, memcmp(expected, scf_buffer_data(&flat), 100))
+        && ASSERT_EQ(0, memcmp("xyz", scf_buffer_data(&flat) + 100, 3));
+    
+    scf_chain_truncate(&chain, 0);
+    return result && ASSERT_EQ(0, chain.size) && ASSERT_TRUE(chain.first == NULL);
+}
+
+bool test_chain_iovecs(void) {
+    scf_chain_append_bytes(&chain, expected, sizeof(expected));
+    scf_iovec iovecs[4];
+    scf_chain_iterator iter = scf_chain_get_iterator(&chain);
+    size_t count = scf_chain_fill_iovecs(&iter, iovecs, 4);
+    bool result = ASSERT_EQ(4, count) && ASSERT_TRUE(iovecs[0].iov_base != NULL);
+    
+    size_t consumed = iovecs[0].iov_len + 5;
+    scf_chain_advance(&iter, consumed);
+    count = scf_chain_fill_iovecs(&iter, iovecs, 4);
+    result &= ASSERT_EQ(4, count)
+        && ASSERT_EQ(0, memcmp(expected + consumed, iovecs[0].iov_base, iovecs[0].iov_len));
+    
+    scf_chain_advance(&iter, sizeof(expected) - consumed);
+    return result && ASSERT_EQ(0, scf_chain_fill_iovecs(&iter, iovecs, 4));
+}
+
+#ifndef WIN32
+bool test_chain_write(void) {
+    scf_chain_append_bytes(&chain, expected, sizeof(expected));
+    int fds[2];
+    pipe(fds);
+    scf_chain_write(&chain, fds[1]);
+    close(fds[1]);
+    
+    char actual[sizeof(expected) + 1];
+    size_t total = 0;
+    ssize_t n;
+    while ((n = read(fds[0], actual + total, sizeof(actual) - total)) > 0) {
+        total += n;
+    }
+    
+    close(fds[0]);
+    return ASSERT_EQ(sizeof(expected), total)
+        && ASSERT_EQ(0, memcmp(expected, actual, total));
+}
+#endif
+
+BEGIN_TEST_GROUP(chain_tests)
+    INIT(chain_tests_init)
+    CLEANUP(chain_tests_cleanup)
+    TEST(test_chain_append)
+    TEST(test_chain_flatten)
+    TEST(test_chain_truncate)
+    TEST(test_chain_iovecs)
+#ifndef WIN32
+    TEST(test_chain_write)
+#endif
+END_TEST_GROUP
@@ -0,0 +1,80 @@
+//
+//  gap_buffer_tests.c
+//  ScafellTest
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "scuts.h"
+#include "gap_buffer.h"
+
+static SCF_OPERATION(op);
+
+void gap_buffer_tests_cleanup(void) {
+    scf_complete(&op);
+}
+
+static bool contents_equal(const scf_gap_buffer *gb, const char *expected) {
+    scf_buffer contents = scf_gap_buffer_to_buffer(gb, &op);
+    return ASSERT_EQ(strlen(expected), contents.size)
+        && ASSERT_EQ(0, memcmp(expected, scf_buffer_data(&contents), contents.size));
+}
+
+bool test_gap_buffer_insert(void) {
+    scf_gap_buffer gb = scf_gap_buffer_create(&op, 0);
+    scf_gap_buffer_insert_bytes(&gb, "hello world", 11);
+    scf_gap_buffer_move_to(&gb, 5);
+    scf_gap_buffer_insert_bytes(&gb, ",", 1);
+    bool result = ASSERT_EQ(6, scf_gap_buffer_cursor(&gb))
+        && ASSERT_EQ(12, scf_gap_buffer_size(&gb))
+        && contents_equal(&gb, "hello, world");
+    
+    scf_gap_buffer_move_to(&gb, 0);
+    scf_gap_buffer_insert_bytes(&gb, ">> ", 3);
+    scf_gap_buffer_move_to(&gb, scf_gap_buffer_size(&gb));
+    scf_gap_buffer_insert_bytes(&gb, "!", 1);
+    return result
+        && contents_equal(&gb, ">> hello, world!")
+        && ASSERT_EQ('w', scf_gap_buffer_get(&gb, 10))
+        && ASSERT_EQ('>', scf_gap_buffer_get(&gb, 0));
+}
+
+bool test_gap_buffer_delete(void) {
+    scf_gap_buffer gb = scf_gap_buffer_from_view(&op, scf_buffer_view_wrap("hello, world", 12));
+    scf_gap_buffer_move_to(&gb, 5);
+    scf_gap_buffer_delete(&gb, 2);
+    bool result = contents_equal(&gb, "helloworld");
+    
+    scf_gap_buffer_backspace(&gb, 4);
+    result &= contents_equal(&gb, "hworld") && ASSERT_EQ(1, scf_gap_buffer_cursor(&gb));
+    
+    scf_buffer_view before, after;
+    scf_gap_buffer_get_views(&gb, &before, &after);
+    return result
+        && ASSERT_EQ(0, scf_buffer_view_compare(before, scf_buffer_view_wrap("h", 1)))
+        && ASSERT_EQ(0, scf_buffer_view_compare(after, scf_buffer_view_wrap("world", 5)));
+}
+
+bool test_gap_buffer_growth(void) {
+    scf_gap_buffer gb = scf_gap_buffer_create(&op, 0);
+    char expected[3001];
+    for (int i = 0; i < 1000; i++) {
+        scf_gap_buffer_insert_bytes(&gb, "abc", 3);
+        scf_gap_buffer_move_to(&gb, scf_gap_buffer_cursor(&gb) - 1);
+        memcpy(expected + 2 * i, "ab", 2);
+    }
+    
+    for (int i = 0; i < 1000; i++) {
+        expected[2000 + i] = 'c';
+    }
+    
+    expected[3000] = 0;
+    return contents_equal(&gb, expected);
+}
+
+BEGIN_TEST_GROUP(gap_buffer_tests)
+    CLEANUP(gap_buffer_tests_cleanup)
+    TEST(test_gap_buffer_insert)
+    TEST(test_gap_buffer_delete)
+    TEST(test_gap_buffer_growth)
+END_TEST_GROUP
@@ -14,6 +14,7 @@
 //
 
 #include <stdio.h>
+#include <string.h>
 #include "scuts.h"
 #include "hash.h"
 
@@ -154,6 +155,232 @@ bool test_collisions(void) {
     return ASSERT_EQ(16, dict.max_collisions);
 }
 
+bool test_remove_keeps_chains(void) {
+    dict = scf_dictionary_create(&op, identity_hash, cmp, 32);
+    for (int i = 0; i < 10; i++) {
+        scf_dictionary_add(&dict, dt_int(i), dt_int(i));
+    }
+    
+    scf_dictionary_remove(&dict, dt_int(3));
+    bool result = ASSERT_TRUE(scf_dictionary_lookup(&dict, dt_int(3)) == NULL);
+    for (int i = 0; i < 10; i++) {
+        if (i == 3) continue;
+        scf_datum *value = scf_dictionary_lookup(&dict, dt_int(i));
+        result &= ASSERT_TRUE(value != NULL) && ASSERT_EQ(i, value->i_value);
+    }
+    
+    return result;
+}
+
+/*
+ * Every combination of layout and options, for the checks below.
+ */
+static const scf_dictionary_options all_options[] = {
+    {SCF_DICTIONARY_ROBIN_HOOD, false, false},
+    {SCF_DICTIONARY_ROBIN_HOOD, true, false},
+    {SCF_DICTIONARY_ROBIN_HOOD, false, true},
+    {SCF_DICTIONARY_ROBIN_HOOD, true, true},
+    {SCF_DICTIONARY_SWISS, false, false},
+    {SCF_DICTIONARY_SWISS, true, false},
+    {SCF_DICTIONARY_SWISS, false, true},
+    {SCF_DICTIONARY_SWISS, true, true}
+};
+
+static bool check_all_options(bool (*check)(scf_dictionary_options options)) {
+    bool result = true;
+    for (size_t i = 0; i < sizeof(all_options) / sizeof(all_options[0]); i++) {
+        result &= check(all_options[i]);
+    }
+    
+    return result;
+}
+
+static bool check_add_remove_and_lookup(scf_dictionary_options options) {
+    dict = scf_dictionary_create_with_options(&op, hash, cmp, 0, options);
+    for (int i = 0; i < 100; i++) {
+        scf_dictionary_add(&dict, dt_int(i), dt_int(2 * i));
+    }
+    
+    for (int i = 0; i < 100; i += 2) {
+        scf_datum removed = scf_dictionary_remove(&dict, dt_int(i));
+        if (!ASSERT_EQ(2 * i, removed.i_value)) return false;
+    }
+    
+    bool result = ASSERT_EQ(50, dict.size);
+    for (int i = 0; i < 100; i++) {
+        scf_datum *value = scf_dictionary_lookup(&dict, dt_int(i));
+        if (i % 2 == 0) {
+            result &= ASSERT_TRUE(value == NULL);
+        } else {
+            result &= ASSERT_TRUE(value != NULL) && ASSERT_EQ(2 * i, value->i_value);
+        }
+    }
+    
+    scf_list items = scf_dictionary_get_items(&op, &dict);
+    return result && ASSERT_EQ(50, items.size) && ASSERT_TRUE(contains_item(items, 99, 198));
+}
+
+bool test_add_remove_and_lookup(void) {
+    return check_all_options(check_add_remove_and_lookup);
+}
+
+static bool check_churn(scf_dictionary_options options) {
+    dict = scf_dictionary_create_with_options(&op, hash, cmp, 0, options);
+    bool result = true;
+    for (int i = 0; i < 10000; i++) {
+        scf_dictionary_add(&dict, dt_int(i), dt_int(2 * i));
+        if (i >= 8) {
+            scf_datum removed = scf_dictionary_remove(&dict, dt_int(i - 8));
+            result &= ASSERT_EQ(2 * (i - 8), removed.i_value);
+        }
+    }
+    
+    for (int i = 10000 - 8; i < 10000; i++) {
+        scf_datum *value = scf_dictionary_lookup(&dict, dt_int(i));
+        result &= ASSERT_TRUE(value != NULL) && ASSERT_EQ(2 * i, value->i_value);
+    }
+    
+    return result
+        && ASSERT_EQ(8, dict.size)
+        && ASSERT_EQ(16, dict.capacity)
+        && ASSERT_TRUE(scf_dictionary_lookup(&dict, dt_int(0)) == NULL);
+}
+
+bool test_churn(void) {
+    return check_all_options(check_churn);
+}
+
+static int hash_calls;
+static int comparison_calls;
+
+static size_t counting_hash(scf_datum key) {
+    hash_calls++;
+    return key.i_value;
+}
+
+static bool counting_cmp(scf_datum k1, scf_datum k2) {
+    comparison_calls++;
+    return cmp(k1, k2);
+}
+
+/*
+ * With stored hashes, growing the table doesn't rehash the keys, and
+ * looking up an absent key whose hash matches none of the stored ones
+ * makes no comparisons.
+ */
+static bool check_stored_hashes(scf_dictionary_options options) {
+    hash_calls = 0;
+    dict = scf_dictionary_create_with_options(&op, counting_hash, counting_cmp, 0, options);
+    for (int i = 0; i < 100; i++) {
+        scf_dictionary_add(&dict, dt_int(i * 16), dt_int(i));
+    }
+    
+    bool result = ASSERT_TRUE(dict.capacity > 16);
+    if (options.store_hashes) {
+        result &= ASSERT_EQ(100, hash_calls);
+    }
+    
+    comparison_calls = 0;
+    for (int i = 0; i < 100; i++) {
+        result &= ASSERT_TRUE(scf_dictionary_lookup(&dict, dt_int(i * 16 + 1)) == NULL);
+    }
+    
+    if (options.store_hashes) {
+        result &= ASSERT_EQ(0, comparison_calls);
+    }
+    
+    for (int i = 0; i < 100; i += 2) {
+        scf_dictionary_remove(&dict, dt_int(i * 16));
+    }
+    
+    for (int i = 0; i < 100; i++) {
+        scf_datum *value = scf_dictionary_lookup(&dict, dt_int(i * 16));
+        result &= i % 2 == 0 ? ASSERT_TRUE(value == NULL) : ASSERT_TRUE(value != NULL && value->i_value == i);
+    }
+    
+    return result;
+}
+
+bool test_stored_hashes(void) {
+    return check_all_options(check_stored_hashes);
+}
+
+#define INCREMENTAL_KEYS 2000
+
+/*
+ * Interleaves additions and removals, so that with incremental
+ * rehashing many of them happen while a migration is under way.
+ */
+static bool check_incremental_rehash(scf_dictionary_options options) {
+    static bool present[INCREMENTAL_KEYS];
+    memset(present, 0, sizeof(present));
+    dict = scf_dictionary_create_with_options(&op, hash, cmp, 0, options);
+    bool result = true;
+    bool seen_old_table = false;
+    for (int i = 0; i < INCREMENTAL_KEYS; i++) {
+        scf_dictionary_add(&dict, dt_int(i), dt_int(2 * i));
+        present[i] = true;
+        if (i % 3 == 0) {
+            int key = i * 7 % (i + 1);
+            scf_datum removed = scf_dictionary_remove(&dict, dt_int(key));
+            result &= ASSERT_EQ(present[key] ? 2 * key : -1, removed.type == DT_NONE ? -1 : removed.i_value);
+            present[key] = false;
+        }
+        
+        if (dict.old_table) {
+            seen_old_table = true;
+            scf_list items = scf_dictionary_get_items(&op, &dict);
+            result &= ASSERT_EQ(dict.size, items.size);
+        }
+    }
+    
+    size_t expected_size = 0;
+    for (int i = 0; i < INCREMENTAL_KEYS; i++) {
+        scf_datum *value = scf_dictionary_lookup(&dict, dt_int(i));
+        if (present[i]) {
+            expected_size++;
+            result &= ASSERT_TRUE(value != NULL) && ASSERT_EQ(2 * i, value->i_value);
+        } else {
+            result &= ASSERT_TRUE(value == NULL);
+        }
+    }
+    
+    return result
+        && ASSERT_TRUE(seen_old_table == options.incremental_rehash)
+        && ASSERT_EQ(expected_size, dict.size);
+}
+
+bool test_incremental_rehash(void) {
+    return check_all_options(check_incremental_rehash);
+}
+
+static size_t int_value_hash(scf_datum key) {
+    return (size_t)key.i_value;
+}
+
+/*
+ * Sequential integers under the identity hash, which leaves all but
+ * the low bits of the hash constant.
+ */
+static bool check_weak_hash(scf_dictionary_options options) {
+    dict = scf_dictionary_create_with_options(&op, int_value_hash, cmp, 0, options);
+    for (int i = 0; i < 20000; i++) {
+        scf_dictionary_add(&dict, dt_int(i), dt_int(i));
+    }
+    
+    bool result = ASSERT_EQ(20000, dict.size) && ASSERT_TRUE(dict.max_collisions < 8);
+    for (int i = 0; i < 20000; i += 97) {
+        scf_datum *value = scf_dictionary_lookup(&dict, dt_int(i));
+        result &= ASSERT_TRUE(value != NULL) && ASSERT_EQ(i, value->i_value);
+    }
+    
+    return result;
+}
+
+bool test_weak_hash(void) {
+    return check_all_options(check_weak_hash);
+}
+
 BEGIN_TEST_GROUP(hash_tests)
     INIT(hash_tests_init)
     CLEANUP(hash_tests_cleanup)
@@ -165,6 +392,12 @@ BEGIN_TEST_GROUP(hash_tests)
     TEST(test_dictionary_remove_not_present)
     TEST(test_dictionary_get_items)
     TEST(test_collisions)
+    TEST(test_remove_keeps_chains)
+    TEST(test_add_remove_and_lookup)
+    TEST(test_churn)
+    TEST(test_stored_hashes)
+    TEST(test_incremental_rehash)
+    TEST(test_weak_hash)
 END_TEST_GROUP
 
 
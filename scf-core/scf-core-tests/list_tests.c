@@ -6,9 +6,12 @@
 //
 
 #include <stdio.h>
+#include <stdint.h>
+#include <setjmp.h>
 #include "scuts.h"
 #include "list.h"
 #include "datum.h"
+#include "err_handling.h"
 
 static scf_list list;
 static SCF_OPERATION(op);
@@ -178,6 +181,54 @@ bool test_for_each(void) {
     return ASSERT_EQ(6, sum);
 }
 
+bool test_reserve_and_shrink(void) {
+    scf_list_reserve(&list, 1000);
+    bool result = ASSERT_EQ(1000, list.capacity);
+    for (int i = 0; i < 1000; i++) {
+        scf_list_add(&list, dt_int(i));
+    }
+    
+    scf_list_remove(&list, 999);
+    scf_list_shrink_to_fit(&list);
+    result &= ASSERT_EQ(999, list.capacity) && ASSERT_EQ(998, list.items[998].i_value);
+    
+    scf_list_reserve(&list, 10);
+    return result && ASSERT_EQ(999, list.capacity);
+}
+
+bool test_growth_factor(void) {
+    scf_list empty = scf_list_create(&op, 0);
+    scf_list_add(&empty, dt_int(0));
+    bool result = ASSERT_EQ(4, empty.capacity);
+    
+    scf_list_set_growth_factor(&list, 1.5f);
+    for (int i = 0; i < 11; i++) {
+        scf_list_add(&list, dt_int(i));
+    }
+    
+    return result && ASSERT_EQ(15, list.capacity) && ASSERT_EQ(10, list.items[10].i_value);
+}
+
+static jmp_buf overflow_jmp;
+static scf_error_code raised_error;
+
+static void overflow_err_handler(const scf_err_info *err_info) {
+    raised_error = err_info->code;
+    longjmp(overflow_jmp, 1);
+}
+
+bool test_reserve_too_large(void) {
+    raised_error = SCF_SUCCESS;
+    scf_set_err_handler(overflow_err_handler);
+    if (!setjmp(overflow_jmp)) {
+        scf_list_reserve(&list, SIZE_MAX / 2);
+    }
+    
+    scf_set_err_handler(NULL);
+    return ASSERT_EQ(SCF_OUT_OF_MEMORY, (int)raised_error)
+        && ASSERT_EQ(10, list.capacity);
+}
+
 BEGIN_TEST_GROUP(list_tests)
     INIT(list_init)
     CLEANUP(list_cleanup)
@@ -190,5 +241,8 @@ BEGIN_TEST_GROUP(list_tests)
     TEST(test_remove_in_middle)
     TEST(test_remove_at_start)
     TEST(test_for_each)
+    TEST(test_reserve_and_shrink)
+    TEST(test_growth_factor)
+    TEST(test_reserve_too_large)
 END_TEST_GROUP
 
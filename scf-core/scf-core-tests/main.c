@@ -16,5 +16,8 @@ int main(int argc, const char * argv[]) {
     REGISTER(hash_tests);
     REGISTER(string_tests);
     REGISTER(buffer_tests);
+    REGISTER(chain_tests);
+    REGISTER(gap_buffer_tests);
+    REGISTER(typed_hash_tests);
     return scuts(argc, argv);
 }
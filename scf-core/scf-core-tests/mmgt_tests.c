@@ -6,8 +6,16 @@
 //
 
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <setjmp.h>
+#ifndef WIN32
+#include <stdatomic.h>
+#include <pthread.h>
+#endif
 #include "scuts.h"
 #include "mmgt.h"
+#include "err_handling.h"
 
 static void *alloc1;
 static void *alloc2;
@@ -64,10 +72,776 @@ bool test_realloc(void) {
     && ASSERT_EQ(1, alloc3_cleanup_count);
 }
 
+bool test_realloc_middle_block(void) {
+    SCF_OPERATION(op);
+    alloc1 = scf_alloc_with_cleanup(&op, cleanup, 10);
+    alloc2 = scf_alloc_with_cleanup(&op, cleanup, 20);
+    alloc3 = scf_alloc_with_cleanup(&op, cleanup, 30);
+    for (int i = 1; i <= 10; i++) {
+        alloc2 = scf_realloc(alloc2, 1000 * i);
+    }
+    
+    scf_complete(&op);
+    
+    return
+    ASSERT_EQ(1, alloc1_cleanup_count)
+    && ASSERT_EQ(1, alloc2_cleanup_count)
+    && ASSERT_EQ(1, alloc3_cleanup_count);
+}
+
+bool test_free(void) {
+    SCF_OPERATION(op);
+    alloc1 = scf_alloc_with_cleanup(&op, cleanup, 10);
+    alloc2 = scf_alloc_with_cleanup(&op, cleanup, 20);
+    scf_free(alloc1);
+    bool result = ASSERT_EQ(1, alloc1_cleanup_count);
+    scf_complete(&op);
+    
+    return result
+    && ASSERT_EQ(1, alloc1_cleanup_count)
+    && ASSERT_EQ(1, alloc2_cleanup_count);
+}
+
+bool test_free_recycles_blocks(void) {
+    SCF_OPERATION(op);
+    alloc1 = scf_alloc(&op, 100);
+    scf_alloc(&op, 100);
+    scf_free(alloc1);
+    alloc2 = scf_alloc(&op, 60);
+    alloc3 = scf_alloc(&op, 60);
+    bool result = ASSERT_TRUE(alloc2 == alloc1) && ASSERT_FALSE(alloc3 == alloc1);
+    
+    scf_free(alloc3);
+    alloc3 = scf_alloc(&op, 200);
+    result &= ASSERT_TRUE(alloc3 != alloc1);
+    scf_complete(&op);
+    return result;
+}
+
+bool test_arena_free(void) {
+    SCF_ARENA_OPERATION(op);
+    alloc1 = scf_alloc(&op, 100);
+    scf_free(alloc1);
+    alloc2 = scf_alloc(&op, 10);
+    bool result = ASSERT_TRUE(alloc2 == alloc1);
+    
+    alloc3 = scf_alloc(&op, 100);
+    scf_free(alloc2);
+    result &= ASSERT_TRUE(scf_alloc(&op, 10) != alloc2);
+    scf_complete(&op);
+    return result;
+}
+
+bool test_arena_alloc_and_free(void) {
+    SCF_ARENA_OPERATION(op);
+    alloc1 = scf_alloc_with_cleanup(&op, cleanup, 10);
+    alloc2 = scf_alloc_with_cleanup(&op, cleanup, 100000);
+    alloc3 = scf_alloc(&op, 20);
+    bool result = ASSERT_TRUE(scf_get_operation(alloc1) == &op)
+        && ASSERT_TRUE(scf_get_operation(alloc2) == &op)
+        && ASSERT_TRUE(scf_get_operation(alloc3) == &op);
+    scf_complete(&op);
+    
+    return result
+    && ASSERT_EQ(1, alloc1_cleanup_count)
+    && ASSERT_EQ(1, alloc2_cleanup_count)
+    && ASSERT_EQ(0, alloc3_cleanup_count)
+    && ASSERT_TRUE(op.first == NULL);
+}
+
+bool test_arena_realloc_in_place(void) {
+    SCF_ARENA_OPERATION(op);
+    alloc1 = scf_alloc_with_cleanup(&op, cleanup, 10);
+    memcpy(alloc1, "abcdefghi", 10);
+    void *p = scf_realloc(alloc1, 1000);
+    bool result = ASSERT_TRUE(p == alloc1);
+    
+    alloc2 = scf_alloc(&op, 10);
+    alloc3 = scf_realloc(alloc1, 2000);
+    result &= ASSERT_FALSE(alloc3 == alloc1);
+    result &= ASSERT_EQ(0, strcmp("abcdefghi", alloc3));
+    scf_complete(&op);
+    
+    return result
+    && ASSERT_EQ(0, alloc1_cleanup_count)
+    && ASSERT_EQ(1, alloc3_cleanup_count);
+}
+
+bool test_arena_many_allocations(void) {
+    SCF_ARENA_OPERATION(op);
+    char *blocks[1000];
+    for (int i = 0; i < 1000; i++) {
+        blocks[i] = scf_alloc(&op, 100);
+        memset(blocks[i], i & 0xFF, 100);
+    }
+    
+    bool result = true;
+    for (int i = 0; i < 1000; i++) {
+        result &= ASSERT_EQ(i & 0xFF, (unsigned char)blocks[i][99]);
+    }
+    
+    scf_complete(&op);
+    return result;
+}
+
+static char cleanup_order[10];
+static int cleanup_order_count;
+
+static void record_cleanup(void *p) {
+    cleanup_order[cleanup_order_count++] = *(char *)p;
+}
+
+static char *alloc_tagged(scf_operation *op, char tag) {
+    char *result = scf_alloc_with_cleanup(op, record_cleanup, 1);
+    *result = tag;
+    return result;
+}
+
+bool test_release_to_mark(void) {
+    SCF_OPERATION(op);
+    cleanup_order_count = 0;
+    char *a = alloc_tagged(&op, 'a');
+    scf_mark mark = scf_operation_mark(&op);
+    alloc_tagged(&op, 'b');
+    alloc_tagged(&op, 'c');
+    a = scf_realloc(a, 1000);
+    scf_operation_release_to(&op, mark);
+    
+    bool result = ASSERT_EQ(2, cleanup_order_count)
+        && ASSERT_EQ('c', cleanup_order[0])
+        && ASSERT_EQ('b', cleanup_order[1])
+        && ASSERT_EQ('a', *a)
+        && ASSERT_EQ(0, op.marks);
+    
+    scf_complete(&op);
+    return result && ASSERT_EQ(3, cleanup_order_count) && ASSERT_EQ('a', cleanup_order[2]);
+}
+
+bool test_arena_release_to_mark(void) {
+    SCF_ARENA_OPERATION(op);
+    cleanup_order_count = 0;
+    char *a = alloc_tagged(&op, 'a');
+    scf_mark outer = scf_operation_mark(&op);
+    char *b = alloc_tagged(&op, 'b');
+    scf_operation_mark(&op);
+    alloc_tagged(&op, 'c');
+    a = scf_realloc(a, 100);
+    for (int i = 0; i < 100; i++) {
+        scf_alloc(&op, 10000);
+    }
+    
+    scf_operation_release_to(&op, outer);
+    bool result = ASSERT_EQ(2, cleanup_order_count)
+        && ASSERT_EQ('c', cleanup_order[0])
+        && ASSERT_EQ('b', cleanup_order[1])
+        && ASSERT_EQ('a', *a)
+        && ASSERT_EQ(0, op.marks);
+    
+    outer = scf_operation_mark(&op);
+    result &= ASSERT_TRUE(alloc_tagged(&op, 'd') == b);
+    scf_complete(&op);
+    return result && ASSERT_EQ(4, cleanup_order_count) && ASSERT_EQ('a', cleanup_order[3]);
+}
+
+bool test_operation_stats(void) {
+    SCF_OPERATION(op);
+    void *p = scf_alloc(&op, 10);
+    scf_alloc(&op, 100);
+    p = scf_realloc(p, 1000);
+    scf_memory_stats stats = scf_operation_stats(&op);
+    bool result = ASSERT_EQ(1100, stats.live_bytes)
+        && ASSERT_EQ(1100, stats.peak_bytes)
+        && ASSERT_EQ(2, stats.alloc_count)
+        && ASSERT_EQ(1, stats.realloc_count)
+        && ASSERT_EQ(1, stats.histogram[0])
+        && ASSERT_EQ(1, stats.histogram[3]);
+    
+    scf_free(p);
+    scf_alloc(&op, 1 << 20);
+    stats = scf_operation_stats(&op);
+    result &= ASSERT_EQ(100 + (1 << 20), stats.live_bytes)
+        && ASSERT_EQ(100 + (1 << 20), stats.peak_bytes)
+        && ASSERT_EQ(1, stats.histogram[SCF_HISTOGRAM_BUCKETS - 1]);
+    
+    scf_complete(&op);
+    stats = scf_operation_stats(&op);
+    return result && ASSERT_EQ(0, stats.live_bytes) && ASSERT_EQ(0, stats.alloc_count);
+}
+
+bool test_arena_operation_stats(void) {
+    SCF_ARENA_OPERATION(op);
+    void *p = scf_alloc(&op, 10);
+    p = scf_realloc(p, 100);
+    scf_mark mark = scf_operation_mark(&op);
+    scf_alloc(&op, 1000);
+    scf_memory_stats stats = scf_operation_stats(&op);
+    bool result = ASSERT_EQ(1100, stats.live_bytes);
+    
+    scf_operation_release_to(&op, mark);
+    stats = scf_operation_stats(&op);
+    result &= ASSERT_EQ(100, stats.live_bytes) && ASSERT_EQ(1100, stats.peak_bytes);
+    scf_complete(&op);
+    return result;
+}
+
+static jmp_buf budget_jmp;
+static scf_error_code raised_error;
+
+static void budget_err_handler(const scf_err_info *err_info) {
+    raised_error = err_info->code;
+    longjmp(budget_jmp, 1);
+}
+
+static bool double_budget(scf_operation *op, size_t required) {
+    (void)required;
+    op->budget *= 2;
+    return true;
+}
+
+bool test_budget_exceeded(void) {
+    SCF_OPERATION(op);
+    scf_operation_set_budget(&op, 1000, NULL);
+    raised_error = SCF_SUCCESS;
+    scf_set_err_handler(budget_err_handler);
+    
+    void *volatile p = NULL;
+    if (!setjmp(budget_jmp)) {
+        p = scf_alloc(&op, 600);
+        p = scf_realloc(p, 900);
+        scf_alloc(&op, 200);
+    }
+    
+    scf_set_err_handler(NULL);
+    scf_memory_stats stats = scf_operation_stats(&op);
+    bool result = ASSERT_EQ(SCF_BUDGET_EXCEEDED, (int)raised_error)
+        && ASSERT_TRUE(p != NULL)
+        && ASSERT_EQ(900, stats.live_bytes);
+    
+    scf_operation_set_budget(&op, 1000, double_budget);
+    scf_alloc(&op, 200);
+    result &= ASSERT_EQ(2000, op.budget);
+    scf_complete(&op);
+    return result;
+}
+
+bool test_budget_return_null(void) {
+    SCF_OPERATION(op);
+    SCF_OPERATION(other_op);
+    scf_operation_set_budget(&op, 1000, NULL);
+    scf_operation_set_budget_failure(&op, SCF_BUDGET_RETURN_NULL);
+    
+    char *p = scf_alloc(&op, 600);
+    strcpy(p, "budgeted");
+    void *q = scf_alloc(&other_op, 600);
+    scf_buffer buf = scf_buffer_create(&other_op, 600);
+    bool result = ASSERT_TRUE(scf_alloc(&op, 600) == NULL)
+        && ASSERT_TRUE(scf_realloc(p, 2000) == NULL)
+        && ASSERT_TRUE(scf_transfer(q, &op) == NULL)
+        && ASSERT_TRUE(scf_get_operation(q) == &other_op)
+        && ASSERT_TRUE(scf_buffer_transfer(&buf, &op) == NULL)
+        && ASSERT_TRUE(buf.operation == &other_op && buf.data != NULL)
+        && ASSERT_EQ(0, strcmp(p, "budgeted"))
+        && ASSERT_EQ(600, scf_operation_stats(&op).live_bytes);
+    
+    scf_complete(&op);
+    scf_complete(&other_op);
+    return result;
+}
+
+bool test_buffer_over_budget(void) {
+    SCF_OPERATION(op);
+    scf_operation_set_budget(&op, 64, NULL);
+    scf_operation_set_budget_failure(&op, SCF_BUDGET_RETURN_NULL);
+    char bytes[200];
+    memset(bytes, 'x', sizeof(bytes));
+    
+    scf_buffer buf = scf_buffer_create(&op, 0);
+    raised_error = SCF_SUCCESS;
+    scf_set_err_handler(budget_err_handler);
+    if (!setjmp(budget_jmp)) {
+        scf_buffer_append_bytes(&buf, bytes, 10);
+        scf_buffer_append_bytes(&buf, bytes, sizeof(bytes));
+    }
+    
+    scf_buffer_view view = scf_buffer_get_view(&buf);
+    bool result = ASSERT_EQ(SCF_BUDGET_EXCEEDED, (int)raised_error)
+        && ASSERT_TRUE(buf.data == NULL)
+        && ASSERT_EQ(SCF_BUFFER_INLINE_CAPACITY, buf.capacity)
+        && ASSERT_EQ(10, view.size);
+    
+    raised_error = SCF_SUCCESS;
+    if (!setjmp(budget_jmp)) {
+        scf_buffer_create(&op, sizeof(bytes));
+    }
+    
+    scf_set_err_handler(NULL);
+    result = result && ASSERT_EQ(SCF_BUDGET_EXCEEDED, (int)raised_error);
+    scf_complete(&op);
+    return result;
+}
+
+static bool is_aligned(const void *p, size_t alignment) {
+    return ((uintptr_t)p & (alignment - 1)) == 0;
+}
+
+static bool check_alignment(scf_operation *op, size_t alignment) {
+    alloc1 = scf_alloc_aligned_with_cleanup(op, cleanup, 10, alignment);
+    memcpy(alloc1, "abcdefghi", 10);
+    bool result = ASSERT_TRUE(is_aligned(alloc1, alignment));
+    
+    alloc2 = scf_alloc(op, 10);
+    alloc3 = scf_realloc(alloc1, 100000);
+    result &= ASSERT_TRUE(is_aligned(alloc3, alignment))
+        && ASSERT_EQ(0, strcmp("abcdefghi", alloc3))
+        && ASSERT_TRUE(scf_get_operation(alloc3) == op)
+        && ASSERT_TRUE(is_aligned(alloc2, 16));
+    return result;
+}
+
+bool test_alloc_aligned(void) {
+    size_t alignments[] = {16, 32, 64, 4096};
+    bool result = true;
+    for (int i = 0; i < 4; i++) {
+        SCF_OPERATION(op);
+        SCF_ARENA_OPERATION(arena_op);
+        mmgt_init();
+        result &= check_alignment(&op, alignments[i]);
+        scf_complete(&op);
+        result &= ASSERT_EQ(1, alloc3_cleanup_count);
+        
+        mmgt_init();
+        result &= check_alignment(&arena_op, alignments[i]);
+        scf_complete(&arena_op);
+        result &= ASSERT_EQ(1, alloc3_cleanup_count);
+    }
+    
+    return result;
+}
+
+bool test_free_aligned(void) {
+    SCF_OPERATION(op);
+    void *p = scf_alloc_aligned(&op, 100, 64);
+    scf_free(p);
+    void *q = scf_alloc(&op, 64);
+    bool result = ASSERT_TRUE(q == p);
+    q = scf_realloc(q, 200);
+    scf_free(scf_alloc_aligned(&op, 100000, 4096));
+    scf_complete(&op);
+    return result && ASSERT_TRUE(is_aligned(q, 64));
+}
+
+static bool check_large_alloc(scf_operation *op) {
+    size_t saved_threshold = scf_mmap_threshold;
+    scf_mmap_threshold = 1024 * 1024;
+    alloc1 = scf_alloc_with_cleanup(op, cleanup, 100000);
+    memset(alloc1, 'x', 100000);
+    alloc1 = scf_realloc(alloc1, 2 * 1024 * 1024);
+    memset((char *)alloc1 + 100000, 'y', 2 * 1024 * 1024 - 100000);
+    alloc1 = scf_realloc(alloc1, 64 * 1024 * 1024);
+    char *p = alloc1;
+    bool result = ASSERT_EQ('x', p[99999])
+        && ASSERT_EQ('y', p[100000])
+        && ASSERT_EQ('y', p[2 * 1024 * 1024 - 1])
+        && ASSERT_TRUE(scf_get_operation(p) == op);
+    
+    p[64 * 1024 * 1024 - 1] = 'z';
+    alloc2 = scf_alloc_with_cleanup(op, cleanup, 3 * 1024 * 1024);
+    scf_free(alloc2);
+    scf_mmap_threshold = saved_threshold;
+    return result;
+}
+
+bool test_large_alloc(void) {
+    SCF_OPERATION(op);
+    SCF_ARENA_OPERATION(arena_op);
+    bool result = check_large_alloc(&op);
+    scf_complete(&op);
+    result &= ASSERT_EQ(1, alloc1_cleanup_count) && ASSERT_EQ(1, alloc2_cleanup_count);
+    
+    mmgt_init();
+    result &= check_large_alloc(&arena_op);
+    scf_complete(&arena_op);
+    return result && ASSERT_EQ(1, alloc1_cleanup_count) && ASSERT_EQ(1, alloc2_cleanup_count);
+}
+
+bool test_reset_retains_memory(void) {
+    SCF_OPERATION(op);
+    scf_operation_set_retention(&op, 1000);
+    alloc1 = scf_alloc_with_cleanup(&op, cleanup, 500);
+    alloc2 = scf_alloc_with_cleanup(&op, cleanup, 600);
+    scf_operation_reset(&op);
+    
+    bool result = ASSERT_EQ(1, alloc1_cleanup_count)
+        && ASSERT_EQ(1, alloc2_cleanup_count)
+        && ASSERT_EQ(0, scf_operation_stats(&op).live_bytes)
+        && ASSERT_TRUE(op.first == NULL);
+    
+    void *p = scf_alloc(&op, 400);
+    void *q = scf_alloc(&op, 400);
+    result &= ASSERT_TRUE(p == alloc1 || p == alloc2) && ASSERT_TRUE(q != alloc1 && q != alloc2);
+    scf_complete(&op);
+    return result && ASSERT_EQ(1, alloc1_cleanup_count);
+}
+
+bool test_arena_reset_retains_slabs(void) {
+    SCF_ARENA_OPERATION(op);
+    scf_operation_set_retention(&op, 1024 * 1024);
+    void *first = scf_alloc(&op, 100);
+    for (int i = 0; i < 100; i++) {
+        scf_alloc(&op, 10000);
+    }
+    
+    alloc1 = scf_alloc_with_cleanup(&op, cleanup, 10);
+    scf_operation_reset(&op);
+    
+    bool result = ASSERT_EQ(1, alloc1_cleanup_count) && ASSERT_TRUE(op.slabs == NULL);
+    void *p = scf_alloc(&op, 100);
+    result &= ASSERT_TRUE(op.slabs != NULL);
+    for (int i = 0; i < 100; i++) {
+        scf_alloc(&op, 10000);
+    }
+    
+    scf_complete(&op);
+    return result && ASSERT_TRUE(p != NULL && first != NULL);
+}
+
+bool test_compact_alloc_and_cleanup(void) {
+    SCF_COMPACT_OPERATION(op);
+    alloc1 = scf_alloc_with_cleanup(&op, cleanup, 10);
+    alloc2 = scf_alloc(&op, 20);
+    alloc3 = scf_alloc_with_cleanup(&op, cleanup, 1000);
+    void *p = scf_alloc(&op, 3);
+    bool result = ASSERT_EQ(24, (char *)alloc2 - (char *)alloc1)
+        && ASSERT_EQ(0, (uintptr_t)p % 8)
+        && ASSERT_TRUE(scf_get_operation(alloc1) == &op)
+        && ASSERT_TRUE(scf_get_operation(alloc3) == &op)
+        && ASSERT_TRUE(scf_get_operation(p) == &op);
+    
+    scf_free(alloc1);
+    result &= ASSERT_EQ(1, alloc1_cleanup_count);
+    scf_complete(&op);
+    return result
+        && ASSERT_EQ(1, alloc1_cleanup_count)
+        && ASSERT_EQ(0, alloc2_cleanup_count)
+        && ASSERT_EQ(1, alloc3_cleanup_count);
+}
+
+bool test_compact_realloc(void) {
+    SCF_COMPACT_OPERATION(op);
+    alloc1 = scf_alloc_with_cleanup(&op, cleanup, 10);
+    strcpy(alloc1, "abcdefghi");
+    void *p = scf_realloc(alloc1, 40);
+    bool result = ASSERT_TRUE(p == alloc1);
+    
+    scf_alloc(&op, 10);
+    alloc1 = scf_realloc(p, 100);
+    result &= ASSERT_TRUE(alloc1 != p) && ASSERT_EQ(0, strcmp("abcdefghi", alloc1));
+    alloc1 = scf_realloc(alloc1, 1000);
+    result &= ASSERT_EQ(0, strcmp("abcdefghi", alloc1)) && ASSERT_TRUE(scf_get_operation(alloc1) == &op);
+    scf_complete(&op);
+    return result && ASSERT_EQ(1, alloc1_cleanup_count);
+}
+
+bool test_compact_release_to_mark(void) {
+    SCF_COMPACT_OPERATION(op);
+    alloc1 = scf_alloc_with_cleanup(&op, cleanup, 10);
+    scf_memory_stats before = scf_operation_stats(&op);
+    scf_mark mark = scf_operation_mark(&op);
+    alloc2 = scf_alloc_with_cleanup(&op, cleanup, 20);
+    scf_alloc(&op, 50000);
+    alloc1 = scf_realloc(alloc1, 200);
+    scf_operation_release_to(&op, mark);
+    
+    scf_memory_stats after = scf_operation_stats(&op);
+    bool result = ASSERT_EQ(0, alloc1_cleanup_count)
+        && ASSERT_EQ(1, alloc2_cleanup_count)
+        && ASSERT_EQ(before.live_bytes, after.live_bytes);
+    alloc2 = NULL;
+    scf_complete(&op);
+    return result && ASSERT_EQ(1, alloc1_cleanup_count);
+}
+
+#define REGISTERED_COUNT 1000
+
+static int registered_cleanup_count;
+
+static void count_registered_cleanup(void *p) {
+    registered_cleanup_count += *(int *)p;
+}
+
+bool test_compact_registry(void) {
+    SCF_COMPACT_OPERATION(op);
+    int *allocations[REGISTERED_COUNT];
+    registered_cleanup_count = 0;
+    for (int i = 0; i < REGISTERED_COUNT; i++) {
+        allocations[i] = scf_alloc_with_cleanup(&op, count_registered_cleanup, sizeof(int));
+        *allocations[i] = 1;
+    }
+    
+    for (int i = 0; i < REGISTERED_COUNT; i += 2) {
+        scf_free(allocations[i]);
+    }
+    
+    bool result = ASSERT_EQ(REGISTERED_COUNT / 2, registered_cleanup_count);
+    for (int i = 1; i < REGISTERED_COUNT; i += 2) {
+        allocations[i] = scf_realloc(allocations[i], 16);
+        *allocations[i] = 2;
+    }
+    
+    scf_complete(&op);
+    return result && ASSERT_EQ(REGISTERED_COUNT / 2 * 3, registered_cleanup_count);
+}
+
+bool test_compact_realloc_under_marks(void) {
+    scf_allocation_counts counts = {0};
+    scf_allocator counting = scf_counting_allocator(&counts);
+    scf_set_allocator(&counting);
+    
+    SCF_COMPACT_OPERATION(op);
+    alloc3 = scf_alloc_with_cleanup(&op, cleanup, 10);
+    scf_mark outer = scf_operation_mark(&op);
+    uint64_t outstanding = counts.alloc_count - counts.free_count;
+    alloc1 = scf_alloc_with_cleanup(&op, cleanup, 10);
+    scf_mark inner = scf_operation_mark(&op);
+    alloc2 = scf_alloc_with_cleanup(&op, cleanup, 20);
+    scf_alloc(&op, 10);
+    alloc1 = scf_realloc(alloc1, 200);
+    alloc2 = scf_realloc(alloc2, 200);
+    scf_operation_release_to(&op, inner);
+    bool result = ASSERT_EQ(0, alloc1_cleanup_count)
+        && ASSERT_EQ(1, alloc2_cleanup_count)
+        && ASSERT_TRUE(scf_get_operation(alloc1) == &op);
+    
+    scf_operation_release_to(&op, outer);
+    result &= ASSERT_EQ(1, alloc1_cleanup_count)
+        && ASSERT_EQ(outstanding, counts.alloc_count - counts.free_count);
+    
+    scf_complete(&op);
+    scf_set_allocator(NULL);
+    return result
+        && ASSERT_EQ(1, alloc3_cleanup_count)
+        && ASSERT_EQ(counts.alloc_count, counts.free_count);
+}
+
+bool test_transfer(void) {
+    SCF_OPERATION(scratch);
+    SCF_OPERATION(dest);
+    alloc1 = scf_alloc_with_cleanup(&scratch, cleanup, 1000);
+    alloc2 = scf_alloc_with_cleanup(&scratch, cleanup, 20);
+    void *p = scf_transfer(alloc1, &dest);
+    bool result = ASSERT_TRUE(p == alloc1)
+        && ASSERT_TRUE(scf_get_operation(p) == &dest)
+        && ASSERT_EQ(1000, scf_operation_stats(&dest).live_bytes)
+        && ASSERT_EQ(20, scf_operation_stats(&scratch).live_bytes);
+    
+    scf_complete(&scratch);
+    result &= ASSERT_EQ(0, alloc1_cleanup_count) && ASSERT_EQ(1, alloc2_cleanup_count);
+    scf_complete(&dest);
+    return result && ASSERT_EQ(1, alloc1_cleanup_count);
+}
+
+bool test_arena_transfer(void) {
+    SCF_ARENA_OPERATION(scratch);
+    SCF_COMPACT_OPERATION(compact_scratch);
+    SCF_OPERATION(dest);
+    void *slab_allocation = scf_alloc_with_cleanup(&scratch, cleanup, 100);
+    void *compact_allocation = scf_alloc_with_cleanup(&compact_scratch, cleanup, 10);
+    strcpy(slab_allocation, "slab");
+    strcpy(compact_allocation, "compact");
+    alloc1 = scf_transfer(slab_allocation, &dest);
+    alloc2 = scf_transfer(compact_allocation, &dest);
+    bool result = ASSERT_TRUE(alloc1 != slab_allocation)
+        && ASSERT_TRUE(scf_get_operation(alloc1) == &dest)
+        && ASSERT_TRUE(scf_get_operation(alloc2) == &dest)
+        && ASSERT_EQ(0, strcmp("slab", alloc1))
+        && ASSERT_EQ(0, strcmp("compact", alloc2))
+        && ASSERT_EQ(0, scf_operation_stats(&compact_scratch).live_bytes);
+    
+    scf_complete(&scratch);
+    scf_complete(&compact_scratch);
+    result &= ASSERT_EQ(0, alloc1_cleanup_count) && ASSERT_EQ(0, alloc2_cleanup_count);
+    scf_complete(&dest);
+    return result && ASSERT_EQ(1, alloc1_cleanup_count) && ASSERT_EQ(1, alloc2_cleanup_count);
+}
+
+bool test_counting_allocator(void) {
+    static scf_allocation_counts counts;
+    scf_allocator counting = scf_counting_allocator(&counts);
+    scf_set_allocator(&counting);
+    
+    SCF_OPERATION(op);
+    SCF_ARENA_OPERATION(arena_op);
+    void *p = scf_alloc(&op, 10);
+    scf_alloc_aligned(&op, 10, 64);
+    p = scf_realloc(p, 20 * 1024 * 1024);
+    scf_free(scf_alloc(&op, 100000));
+    scf_alloc(&arena_op, 10);
+    scf_alloc(&arena_op, 100000);
+    scf_complete(&op);
+    scf_complete(&arena_op);
+    scf_set_allocator(NULL);
+    
+    return ASSERT_EQ(5, counts.alloc_count)
+        && ASSERT_EQ(1, counts.realloc_count)
+        && ASSERT_EQ(5, counts.free_count);
+}
+
+bool test_profile(void) {
+    static const char outer[] = "outer";
+    static const char inner[] = "inner";
+    SCF_OPERATION(op);
+    scf_profile_start(64);
+    scf_profile_push_tag(outer);
+    for (int i = 0; i < 100; i++) {
+        scf_alloc(&op, 32);
+    }
+    
+    scf_profile_push_tag(inner);
+    scf_profile_push_tag(inner);
+    scf_alloc(&op, 4096);
+    scf_profile_pop_tag();
+    scf_profile_pop_tag();
+    scf_profile_pop_tag();
+    scf_profile_stop();
+    scf_alloc(&op, 4096);
+    scf_complete(&op);
+    
+    char profile[1024] = {0};
+    FILE *out = tmpfile();
+    scf_profile_write(out);
+    rewind(out);
+    fread(profile, 1, sizeof(profile) - 1, out);
+    fclose(out);
+    
+    return ASSERT_TRUE(strstr(profile, "outer;inner 4096\n") != NULL)
+        && ASSERT_TRUE(strstr(profile, "\nouter ") != NULL || strncmp(profile, "outer ", 6) == 0)
+        && ASSERT_TRUE(strstr(profile, "inner;inner") == NULL);
+}
+
+#ifndef WIN32
+#define THREAD_COUNT 4
+#define ALLOCS_PER_THREAD 10000
+
+static SCF_CONCURRENT_OPERATION(shared_op);
+static atomic_int concurrent_cleanup_count;
+static atomic_int wrong_operation_count;
+
+static void concurrent_cleanup(void *p) {
+    (void)p;
+    atomic_fetch_add(&concurrent_cleanup_count, 1);
+}
+
+static void *allocate_into_shared_op(void *arg) {
+    (void)arg;
+    for (int i = 0; i < ALLOCS_PER_THREAD; i++) {
+        int *p = scf_alloc_with_cleanup(&shared_op, concurrent_cleanup, sizeof(int) * (1 + i % 8));
+        *p = i;
+        if (i % 3 == 0) p = scf_realloc(p, 200);
+        if (scf_get_operation(p) != &shared_op) atomic_fetch_add(&wrong_operation_count, 1);
+    }
+    
+    return NULL;
+}
+
+bool test_concurrent_operation(void) {
+    atomic_store(&concurrent_cleanup_count, 0);
+    atomic_store(&wrong_operation_count, 0);
+    
+    pthread_t threads[THREAD_COUNT];
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        pthread_create(&threads[i], NULL, allocate_into_shared_op, NULL);
+    }
+    
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    
+    scf_memory_stats stats = scf_operation_stats(&shared_op);
+    scf_complete(&shared_op);
+    bool result = ASSERT_EQ(THREAD_COUNT * ALLOCS_PER_THREAD, stats.alloc_count)
+        && ASSERT_EQ(THREAD_COUNT * ALLOCS_PER_THREAD, atomic_load(&concurrent_cleanup_count))
+        && ASSERT_EQ(0, atomic_load(&wrong_operation_count));
+    
+    allocate_into_shared_op(NULL);
+    scf_operation_set_retention(&shared_op, 1024 * 1024);
+    scf_operation_reset(&shared_op);
+    result &= ASSERT_EQ((THREAD_COUNT + 1) * ALLOCS_PER_THREAD, atomic_load(&concurrent_cleanup_count));
+    allocate_into_shared_op(NULL);
+    scf_complete(&shared_op);
+    return result && ASSERT_EQ((THREAD_COUNT + 2) * ALLOCS_PER_THREAD, atomic_load(&concurrent_cleanup_count));
+}
+
+#define CONCURRENT_BUDGET (1024 * 1024)
+
+static SCF_CONCURRENT_OPERATION(budgeted_op);
+static atomic_size_t budgeted_bytes;
+
+static void *allocate_until_budget(void *arg) {
+    (void)arg;
+    while (scf_alloc(&budgeted_op, 1000)) {
+        atomic_fetch_add(&budgeted_bytes, 1000);
+    }
+    
+    return NULL;
+}
+
+bool test_concurrent_budget(void) {
+    scf_operation_set_budget(&budgeted_op, CONCURRENT_BUDGET, NULL);
+    scf_operation_set_budget_failure(&budgeted_op, SCF_BUDGET_RETURN_NULL);
+    atomic_store(&budgeted_bytes, 0);
+    
+    pthread_t threads[THREAD_COUNT];
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        pthread_create(&threads[i], NULL, allocate_until_budget, NULL);
+    }
+    
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    
+    size_t allocated = atomic_load(&budgeted_bytes);
+    scf_complete(&budgeted_op);
+    return ASSERT_TRUE(allocated > CONCURRENT_BUDGET - THREAD_COUNT * 64 * 1024)
+        && ASSERT_TRUE(allocated <= CONCURRENT_BUDGET + THREAD_COUNT * 64 * 1024);
+}
+#endif
+
 BEGIN_TEST_GROUP(mmgt_tests)
     INIT(mmgt_init)
     TEST(test_alloc_and_free)
     TEST(test_realloc)
+    TEST(test_realloc_middle_block)
+    TEST(test_free)
+    TEST(test_free_recycles_blocks)
+    TEST(test_arena_free)
+    TEST(test_arena_alloc_and_free)
+    TEST(test_arena_realloc_in_place)
+    TEST(test_arena_many_allocations)
+    TEST(test_release_to_mark)
+    TEST(test_arena_release_to_mark)
+    TEST(test_operation_stats)
+    TEST(test_arena_operation_stats)
+    TEST(test_budget_exceeded)
+    TEST(test_budget_return_null)
+    TEST(test_buffer_over_budget)
+    TEST(test_alloc_aligned)
+    TEST(test_free_aligned)
+    TEST(test_large_alloc)
+    TEST(test_reset_retains_memory)
+    TEST(test_arena_reset_retains_slabs)
+    TEST(test_compact_alloc_and_cleanup)
+    TEST(test_compact_realloc)
+    TEST(test_compact_release_to_mark)
+    TEST(test_compact_registry)
+    TEST(test_compact_realloc_under_marks)
+    TEST(test_transfer)
+    TEST(test_arena_transfer)
+    TEST(test_counting_allocator)
+    TEST(test_profile)
+#ifndef WIN32
+    TEST(test_concurrent_operation)
+    TEST(test_concurrent_budget)
+#endif
 END_TEST_GROUP
 
 
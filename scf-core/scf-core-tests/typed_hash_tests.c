@@ -0,0 +1,120 @@
+//
+//  typed_hash_tests.c
+//  ScafellTest
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "scuts.h"
+#include "typed_hash.h"
+
+static size_t collide(int key) {
+    return key % 4;
+}
+
+static bool same_string(const char *s1, const char *s2) {
+    return strcmp(s1, s2) == 0;
+}
+
+static size_t hash_string(const char *s) {
+    size_t h = 5381;
+    while (*s) {
+        h = h * 33 + (unsigned char)*s++;
+    }
+    
+    return h;
+}
+
+static size_t hash_pointer(void *p) {
+    return scf_hash_uint64((uintptr_t)p);
+}
+
+SCF_DEFINE_MAP(int_map, int, int, collide, SCF_VALUE_EQUAL)
+SCF_DEFINE_MAP(string_map, const char *, double, hash_string, same_string)
+SCF_DEFINE_SET(ptr_set, void *, hash_pointer, SCF_VALUE_EQUAL)
+
+static SCF_OPERATION(op);
+
+void typed_hash_tests_cleanup(void) {
+    scf_complete(&op);
+}
+
+bool test_typed_map_add_and_lookup(void) {
+    int_map map = int_map_create(&op, 0);
+    bool result = true;
+    for (int i = 0; i < 100; i++) {
+        result &= ASSERT_TRUE(int_map_add(&map, i, 2 * i));
+    }
+    
+    result &= ASSERT_FALSE(int_map_add(&map, 7, 99)) && ASSERT_EQ(100, map.size);
+    for (int i = 0; i < 100; i++) {
+        int *value = int_map_lookup(&map, i);
+        result &= ASSERT_TRUE(value != NULL) && ASSERT_EQ(i == 7 ? 99 : 2 * i, *value);
+    }
+    
+    return result && ASSERT_TRUE(int_map_lookup(&map, 100) == NULL);
+}
+
+bool test_typed_map_remove(void) {
+    int_map map = int_map_create(&op, 0);
+    for (int i = 0; i < 1000; i++) {
+        int_map_add(&map, i, i);
+        if (i >= 8) {
+            int removed = -1;
+            if (!ASSERT_TRUE(int_map_remove(&map, i - 8, &removed)) || !ASSERT_EQ(i - 8, removed)) return false;
+        }
+    }
+    
+    bool result = ASSERT_EQ(8, map.size)
+        && ASSERT_FALSE(int_map_remove(&map, 0, NULL))
+        && ASSERT_TRUE(int_map_lookup(&map, 991) == NULL);
+    for (int i = 992; i < 1000; i++) {
+        int *value = int_map_lookup(&map, i);
+        result &= ASSERT_TRUE(value != NULL) && ASSERT_EQ(i, *value);
+    }
+    
+    return result;
+}
+
+bool test_typed_map_iteration(void) {
+    string_map map = string_map_create(&op, 0);
+    string_map_add(&map, "one", 1.0);
+    string_map_add(&map, "two", 2.0);
+    string_map_add(&map, "three", 3.0);
+    
+    double total = 0;
+    size_t index = 0;
+    string_map_entry *entry;
+    while (string_map_next(&map, &index, &entry)) {
+        total += entry->value;
+    }
+    
+    double *two = string_map_lookup(&map, "two");
+    return ASSERT_TRUE(total == 6.0) && ASSERT_TRUE(two != NULL && *two == 2.0);
+}
+
+bool test_typed_set(void) {
+    int values[50];
+    ptr_set set = ptr_set_create(&op, 0);
+    for (int i = 0; i < 50; i++) {
+        ptr_set_add(&set, values + i);
+    }
+    
+    bool result = ASSERT_FALSE(ptr_set_add(&set, values))
+        && ASSERT_TRUE(ptr_set_remove(&set, values + 10))
+        && ASSERT_FALSE(ptr_set_remove(&set, values + 10))
+        && ASSERT_EQ(49, set.size);
+    for (int i = 0; i < 50; i++) {
+        result &= ASSERT_TRUE((i != 10) == ptr_set_contains(&set, values + i));
+    }
+    
+    return result;
+}
+
+BEGIN_TEST_GROUP(typed_hash_tests)
+    CLEANUP(typed_hash_tests_cleanup)
+    TEST(test_typed_map_add_and_lookup)
+    TEST(test_typed_map_remove)
+    TEST(test_typed_map_iteration)
+    TEST(test_typed_set)
+END_TEST_GROUP
@@ -0,0 +1,216 @@
+//
+//  typed_hash.h
+//  scafell
+//
+
+#ifndef typed_hash_h
+#define typed_hash_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mmgt.h"
+#include "hash_mix.h"
+
+/*-------------------------------------------------------------------
+ * Type-specialised hash maps and sets.
+ *
+ * SCF_DEFINE_MAP(name, K, V, hash, equal) defines a map type 'name'
+ * from keys of type K to values of type V, and static inline functions
+ * to use it:
+ *
+ *     name name_create(scf_operation *operation, size_t initial_capacity);
+ *     bool name_add(name *map, K key, V value);     (true if key is new)
+ *     V *name_lookup(const name *map, K key);        (NULL if absent)
+ *     bool name_remove(name *map, K key, V *value);  (value may be NULL)
+ *     bool name_next(const name *map, size_t *index, name_entry **entry);
+ *
+ * SCF_DEFINE_SET(name, K, hash, equal) defines a set type similarly,
+ * with name_create, name_add, name_contains, name_remove and
+ * name_next.
+ *
+ * 'hash' and 'equal' are used as hash(key) and equal(k1, k2), and may
+ * be functions or function-like macros; either way they are inlined
+ * where the compiler can see them, and the keys and values are stored
+ * unboxed, so these avoid the per-item tagging and indirect calls of
+ * scf_dictionary and scf_set. SCF_VALUE_EQUAL suits scalar keys, and
+ * scf_hash_uint64 suits integer or pointer keys.
+ *
+ * The tables use Robin Hood open addressing with backward-shift
+ * removal, as scf_dictionary does by default. name_next iterates over
+ * the entries: start with *index == 0, and it returns false at the
+ * end. Adding or removing entries invalidates entry pointers and
+ * iteration.
+ ------------------------------------------------------------------*/
+
+#define SCF_VALUE_EQUAL(k1, k2) ((k1) == (k2))
+
+/*
+ * The parts shared by maps and sets, given an entry type with a 'key'
+ * member.
+ */
+#define SCF_DEFINE_TABLE_(name, K, hash, equal) \
+    typedef struct { \
+        size_t size; \
+        size_t capacity; \
+        name##_entry *entries; \
+        uint32_t *probe_lengths; \
+        scf_operation *operation; \
+    } name; \
+    \
+    static inline void name##_set_storage_(name *table, size_t capacity) { \
+        table->entries = scf_require_allocation(scf_alloc(table->operation, (sizeof(name##_entry) + sizeof(uint32_t)) * capacity)); \
+        table->probe_lengths = (uint32_t *)(table->entries + capacity); \
+        table->capacity = capacity; \
+        memset(table->probe_lengths, 0, sizeof(uint32_t) * capacity); \
+    } \
+    \
+    static inline name name##_create(scf_operation *operation, size_t initial_capacity) { \
+        size_t capacity = 16; \
+        while (capacity < initial_capacity) { \
+            capacity *= 2; \
+        } \
+        \
+        name result = {0, 0, NULL, NULL, operation}; \
+        name##_set_storage_(&result, capacity); \
+        return result; \
+    } \
+    \
+    static inline size_t name##_find_(const name *table, K key) { \
+        size_t mask = table->capacity - 1; \
+        size_t index = (hash(key)) & mask; \
+        for (uint32_t probe_length = 1;; probe_length++) { \
+            uint32_t resident_length = table->probe_lengths[index]; \
+            if (resident_length < probe_length) return SIZE_MAX; \
+            \
+            if (resident_length == probe_length && (equal(table->entries[index].key, key))) return index; \
+            \
+            index = (index + 1) & mask; \
+        } \
+    } \
+    \
+    static inline void name##_insert_new_(name *table, name##_entry entry) { \
+        size_t mask = table->capacity - 1; \
+        size_t index = (hash(entry.key)) & mask; \
+        for (uint32_t probe_length = 1;; probe_length++) { \
+            uint32_t resident_length = table->probe_lengths[index]; \
+            if (resident_length < probe_length) { \
+                name##_entry displaced = table->entries[index]; \
+                table->entries[index] = entry; \
+                table->probe_lengths[index] = probe_length; \
+                if (resident_length == 0) return; \
+                \
+                entry = displaced; \
+                probe_length = resident_length; \
+            } \
+            \
+            index = (index + 1) & mask; \
+        } \
+    } \
+    \
+    static inline void name##_ensure_capacity_(name *table) { \
+        if (4 * (table->size + 1) <= 3 * table->capacity) return; \
+        \
+        name##_entry *entries = table->entries; \
+        uint32_t *probe_lengths = table->probe_lengths; \
+        size_t capacity = table->capacity; \
+        name##_set_storage_(table, 2 * capacity); \
+        for (size_t i = 0; i < capacity; i++) { \
+            if (probe_lengths[i]) name##_insert_new_(table, entries[i]); \
+        } \
+        \
+        scf_free(entries); \
+    } \
+    \
+    static inline void name##_remove_at_(name *table, size_t index) { \
+        size_t mask = table->capacity - 1; \
+        size_t next = (index + 1) & mask; \
+        while (table->probe_lengths[next] > 1) { \
+            table->entries[index] = table->entries[next]; \
+            table->probe_lengths[index] = table->probe_lengths[next] - 1; \
+            index = next; \
+            next = (next + 1) & mask; \
+        } \
+        \
+        table->probe_lengths[index] = 0; \
+        table->size--; \
+    } \
+    \
+    static inline bool name##_next(const name *table, size_t *index, name##_entry **entry) { \
+        for (; *index < table->capacity; (*index)++) { \
+            if (table->probe_lengths[*index]) { \
+                *entry = table->entries + (*index)++; \
+                return true; \
+            } \
+        } \
+        \
+        return false; \
+    }
+
+#define SCF_DEFINE_MAP(name, K, V, hash, equal) \
+    typedef struct { \
+        K key; \
+        V value; \
+    } name##_entry; \
+    \
+    SCF_DEFINE_TABLE_(name, K, hash, equal) \
+    \
+    static inline V *name##_lookup(const name *map, K key) { \
+        size_t index = name##_find_(map, key); \
+        return index == SIZE_MAX ? NULL : &map->entries[index].value; \
+    } \
+    \
+    static inline bool name##_add(name *map, K key, V value) { \
+        size_t index = name##_find_(map, key); \
+        if (index != SIZE_MAX) { \
+            map->entries[index].value = value; \
+            return false; \
+        } \
+        \
+        name##_ensure_capacity_(map); \
+        name##_entry entry = {key, value}; \
+        name##_insert_new_(map, entry); \
+        map->size++; \
+        return true; \
+    } \
+    \
+    static inline bool name##_remove(name *map, K key, V *value) { \
+        size_t index = name##_find_(map, key); \
+        if (index == SIZE_MAX) return false; \
+        \
+        if (value) *value = map->entries[index].value; \
+        name##_remove_at_(map, index); \
+        return true; \
+    }
+
+#define SCF_DEFINE_SET(name, K, hash, equal) \
+    typedef struct { \
+        K key; \
+    } name##_entry; \
+    \
+    SCF_DEFINE_TABLE_(name, K, hash, equal) \
+    \
+    static inline bool name##_contains(const name *set, K key) { \
+        return name##_find_(set, key) != SIZE_MAX; \
+    } \
+    \
+    static inline bool name##_add(name *set, K key) { \
+        if (name##_find_(set, key) != SIZE_MAX) return false; \
+        \
+        name##_ensure_capacity_(set); \
+        name##_entry entry = {key}; \
+        name##_insert_new_(set, entry); \
+        set->size++; \
+        return true; \
+    } \
+    \
+    static inline bool name##_remove(name *set, K key) { \
+        size_t index = name##_find_(set, key); \
+        if (index == SIZE_MAX) return false; \
+        \
+        name##_remove_at_(set, index); \
+        return true; \
+    }
+
+#endif /* typed_hash_h */
@@ -9,7 +9,7 @@
 #include "ucs_db.h"
 #include "err_handling.h"
 
-typedef ucs_utf8_char (*extractor)(const scf_buffer *, size_t *index);
+typedef ucs_utf8_char (*extractor)(scf_buffer_view, size_t *index);
 
 typedef bool (*appender)(scf_buffer *, ucs_utf8_char);
 
@@ -56,12 +56,16 @@ ucs_utf8_char ucs_codepoint_to_utf8(ucs_codepoint cp) {
 }
 
 ucs_utf8_char ucs_utf8_get(const scf_buffer *buf, size_t *index) {
+    return ucs_utf8_get_view(scf_buffer_get_view(buf), index);
+}
+
+ucs_utf8_char ucs_utf8_get_view(scf_buffer_view buf, size_t *index) {
     
-    if (*index >= buf->size) {
+    if (*index >= buf.size) {
         return UCS_INVALID;
     }
     
-    unsigned const char *current = buf->data + *index;
+    unsigned const char *current = buf.data + *index;
     unsigned char first_byte = current[0];
     if (first_byte <= 0x7F) {
         *index += 1;
@@ -76,7 +80,7 @@ ucs_utf8_char ucs_utf8_get(const scf_buffer *buf, size_t *index) {
         case 0x19:
         case 0x1A:
         case 0x1B:
-            if (*index + 2 <= buf->size) {
+            if (*index + 2 <= buf.size) {
                 result = ((ucs_utf8_char)current[0] << 8) | current[1];
                 *index += 2;
             }
@@ -84,14 +88,14 @@ ucs_utf8_char ucs_utf8_get(const scf_buffer *buf, size_t *index) {
             break;
         case 0x1C:
         case 0x1D:
-            if (*index + 3 <= buf->size) {
+            if (*index + 3 <= buf.size) {
                 result = ((ucs_utf8_char)current[0] << 16) | ((ucs_utf8_char)current[1] << 8) | current[2];
                 *index += 3;
             }
             
             break;
         case 0x1E:
-            if (*index + 4 <= buf->size) {
+            if (*index + 4 <= buf.size) {
                 result = ((ucs_utf8_char)current[0] << 24);
                 result |= ((ucs_utf8_char)current[1] << 16);
                 result |= ((ucs_utf8_char)current[2] << 8);
@@ -141,10 +145,10 @@ bool ucs_utf8_append(scf_buffer *buf, ucs_utf8_char ch) {
  * UTF32-specific logic
  *---------------------------------*/
 
-static ucs_codepoint utf32_get_codepoint(const scf_buffer *buf, size_t *index, bool le) {
+static ucs_codepoint utf32_get_codepoint(scf_buffer_view buf, size_t *index, bool le) {
     ucs_codepoint result;
-    if (*index + 4 <= buf->size) {
-        const unsigned char *current = buf->data + *index;
+    if (*index + 4 <= buf.size) {
+        const unsigned char *current = buf.data + *index;
         *index += 4;
         if (le) {
             result = current[0];
@@ -182,12 +186,12 @@ static bool utf32_append_codepoint(scf_buffer *buf, ucs_codepoint cp, bool le) {
     return true;
 }
 
-static ucs_utf8_char utf32le_get(const scf_buffer *buf, size_t *index) {
+static ucs_utf8_char utf32le_get(scf_buffer_view buf, size_t *index) {
     ucs_codepoint cp = utf32_get_codepoint(buf, index, true);
     return cp == UCS_INVALID ? cp : ucs_codepoint_to_utf8(cp);
 }
 
-static ucs_utf8_char utf32be_get(const scf_buffer *buf, size_t *index) {
+static ucs_utf8_char utf32be_get(scf_buffer_view buf, size_t *index) {
     ucs_codepoint cp = utf32_get_codepoint(buf, index, false);
     return cp == UCS_INVALID ? cp : ucs_codepoint_to_utf8(cp);
 }
@@ -236,17 +240,17 @@ static inline bool is_low_surrogate(uint16_t unit) {
     return (unit >= first_low_surrogate) && (unit <= last_low_surrogate);
 }
 
-static ucs_codepoint utf16_get_codepoint(const scf_buffer *buf, size_t *index, bool le) {
+static ucs_codepoint utf16_get_codepoint(scf_buffer_view buf, size_t *index, bool le) {
     ucs_codepoint result = UCS_INVALID;
-    if (*index + 2 <= buf->size)
+    if (*index + 2 <= buf.size)
     {
-        uint16_t first_unit = get_unit(buf->data + *index, le);
+        uint16_t first_unit = get_unit(buf.data + *index, le);
         result = first_unit;
         *index += 2;
         
         if (is_high_surrogate(first_unit)) {
-            if (*index + 2 <= buf->size) {
-                uint16_t second_unit = get_unit(buf->data + *index, le);
+            if (*index + 2 <= buf.size) {
+                uint16_t second_unit = get_unit(buf.data + *index, le);
                 if (is_low_surrogate(second_unit)) {
                     result = ((first_unit - first_high_surrogate) << 10) + second_unit - first_low_surrogate;
                     result += 0x10000;
@@ -259,12 +263,12 @@ static ucs_codepoint utf16_get_codepoint(const scf_buffer *buf, size_t *index, b
     return result;
 }
 
-static ucs_utf8_char utf16le_get(const scf_buffer *buf, size_t *index) {
+static ucs_utf8_char utf16le_get(scf_buffer_view buf, size_t *index) {
     ucs_codepoint cp = utf16_get_codepoint(buf, index, true);
     return cp == UCS_INVALID ? cp : ucs_codepoint_to_utf8(cp);
 }
 
-static ucs_utf8_char utf16be_get(const scf_buffer *buf, size_t *index) {
+static ucs_utf8_char utf16be_get(scf_buffer_view buf, size_t *index) {
     ucs_codepoint cp = utf16_get_codepoint(buf, index, false);
     return cp == UCS_INVALID ? cp : ucs_codepoint_to_utf8(cp);
 }
@@ -305,7 +309,7 @@ static bool utf16be_append(scf_buffer *buf, ucs_utf8_char ch) {
 static extractor get_extractor(ucs_encoding enc) {
     switch ((int)enc) {
         case UCS_UTF8:
-            return ucs_utf8_get;
+            return ucs_utf8_get_view;
         case UCS_UTF16:
         case UCS_UTF16 | UCS_LE:
             return utf16le_get;
@@ -346,12 +350,21 @@ size_t ucs_encode(
                   ucs_encoding source_encoding,
                   scf_buffer *target,
                   ucs_encoding target_encoding) {
+    return ucs_encode_view(scf_buffer_get_view(source), offset, source_encoding, target, target_encoding);
+}
+
+size_t ucs_encode_view(
+                  scf_buffer_view source,
+                  size_t offset,
+                  ucs_encoding source_encoding,
+                  scf_buffer *target,
+                  ucs_encoding target_encoding) {
     extractor extract = get_extractor(source_encoding);
     appender append = get_appender(target_encoding);
     size_t original_target_size = target->size;
     size_t charcount = 0;
     size_t index = offset;
-    while (index < source->size) {
+    while (index < source.size) {
         ucs_utf8_char ch = extract(source, &index);
         if (ch == UCS_INVALID) goto encoding_failed;
         if (!append(target, ch)) goto encoding_failed;
@@ -365,4 +378,44 @@ encoding_failed:
     return SIZE_MAX;
 }
 
+/*
+ * Bytes are encoded into a small staging buffer and moved into the
+ * chain in batches, so that the appenders can stay buffer-based. The
+ * staging buffer never outgrows its inline storage, so it needs no
+ * operation.
+ */
+#define MAX_ENCODED_CHAR_SIZE 4
+
+size_t ucs_encode_to_chain(
+                  scf_buffer_view source,
+                  size_t offset,
+                  ucs_encoding source_encoding,
+                  scf_chain *target,
+                  ucs_encoding target_encoding) {
+    extractor extract = get_extractor(source_encoding);
+    appender append = get_appender(target_encoding);
+    size_t original_target_size = target->size;
+    scf_buffer staging = scf_buffer_create(NULL, 0);
+    size_t charcount = 0;
+    size_t index = offset;
+    while (index < source.size) {
+        ucs_utf8_char ch = extract(source, &index);
+        if (ch == UCS_INVALID) goto encoding_failed;
+        if (!append(&staging, ch)) goto encoding_failed;
+        charcount++;
+        
+        if (staging.capacity - staging.size < MAX_ENCODED_CHAR_SIZE) {
+            scf_chain_append_buffer(target, &staging);
+            staging.size = 0;
+        }
+    }
+    
+    scf_chain_append_buffer(target, &staging);
+    return charcount;
+    
+encoding_failed:
+    scf_chain_truncate(target, original_target_size);
+    return SIZE_MAX;
+}
+
 
@@ -12,6 +12,7 @@
 #include <stdint.h>
 
 #include "mmgt.h"
+#include "chain.h"
 #include "ucs_db.h"
 
 typedef enum {
@@ -32,6 +33,8 @@ ucs_utf8_char ucs_codepoint_to_utf8(ucs_codepoint cp);
 
 ucs_utf8_char ucs_utf8_get(const scf_buffer *buf, size_t *index);
 
+ucs_utf8_char ucs_utf8_get_view(scf_buffer_view buf, size_t *index);
+
 bool ucs_utf8_append(scf_buffer *buf, ucs_utf8_char ch);
 
 
@@ -51,4 +54,29 @@ size_t ucs_encode(
                   scf_buffer *target,
                   ucs_encoding target_encoding);
 
+/*------------------------------------------------------------
+ * As ucs_encode, but reads the source bytes through a view,
+ * so that a slice of a larger input can be converted without
+ * first being copied out.
+ -----------------------------------------------------------*/
+size_t ucs_encode_view(
+                  scf_buffer_view source,
+                  size_t offset,
+                  ucs_encoding source_encoding,
+                  scf_buffer *target,
+                  ucs_encoding target_encoding);
+
+/*------------------------------------------------------------
+ * As ucs_encode_view, but appends the converted bytes to a
+ * chain, so that large outputs are built without repeatedly
+ * reallocating and copying a contiguous target. On failure
+ * the chain is truncated to its original size.
+ -----------------------------------------------------------*/
+size_t ucs_encode_to_chain(
+                  scf_buffer_view source,
+                  size_t offset,
+                  ucs_encoding source_encoding,
+                  scf_chain *target,
+                  ucs_encoding target_encoding);
+
 #endif /* codecs_h */
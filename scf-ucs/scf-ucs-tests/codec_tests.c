@@ -41,7 +41,7 @@ static bool test_valid_utf8_encoding(void) {
     size_t result = ucs_encode(&source, 0, UCS_UTF8, &target, UCS_UTF8);
     ASSERT_EQ(3, result);
     result = result && ASSERT_EQ(7, target.size);
-    bool data_matches = memcmp(data, target.data, 7) == 0;
+    bool data_matches = memcmp(data, scf_buffer_data(&target), 7) == 0;
     result = result && ASSERT_TRUE(data_matches);
     return result;
 }
@@ -67,7 +67,7 @@ static bool test_utf16_le_to_utf8(void) {
     ASSERT_EQ(3, result);
     
     result = result && ASSERT_EQ(UTF8_LEN, target.size);
-    result = result && ASSERT_EQ(0, memcmp(target.data, utf8_encoded_test_data, UTF8_LEN));
+    result = result && ASSERT_EQ(0, memcmp(scf_buffer_data(&target), utf8_encoded_test_data, UTF8_LEN));
     return result;
 }
 
@@ -78,7 +78,7 @@ static bool test_utf8_to_utf16_le(void) {
     ASSERT_EQ(3, result);
     
     result = result && ASSERT_EQ(UTF16_LEN, target.size);
-    result = result && ASSERT_EQ(0, memcmp(target.data, utf16_le_encoded_test_data, UTF16_LEN));
+    result = result && ASSERT_EQ(0, memcmp(scf_buffer_data(&target), utf16_le_encoded_test_data, UTF16_LEN));
     return result;
 }
 
@@ -89,7 +89,7 @@ static bool test_utf32_le_to_utf8(void) {
     ASSERT_EQ(3, result);
     
     result = result && ASSERT_EQ(UTF8_LEN, target.size);
-    result = result && ASSERT_EQ(0, memcmp(target.data, utf8_encoded_test_data, UTF8_LEN));
+    result = result && ASSERT_EQ(0, memcmp(scf_buffer_data(&target), utf8_encoded_test_data, UTF8_LEN));
     return result;
 }
 
@@ -100,10 +100,29 @@ static bool test_utf8_to_utf32_le(void) {
     ASSERT_EQ(3, result);
     
     result = result && ASSERT_EQ(UTF32_LEN, target.size);
-    result = result && ASSERT_EQ(0, memcmp(target.data, utf32_le_encoded_test_data, UTF32_LEN));
+    result = result && ASSERT_EQ(0, memcmp(scf_buffer_data(&target), utf32_le_encoded_test_data, UTF32_LEN));
     return result;
 }
 
+static bool test_utf8_to_utf16_le_chain(void) {
+    scf_chain target = scf_chain_create(&op, 32);
+    scf_chain_append_bytes(&target, "x", 1);
+    for (int i = 0; i < 10; i++) {
+        size_t result = ucs_encode_to_chain(scf_buffer_view_wrap(utf8_encoded_test_data, UTF8_LEN), 0, UCS_UTF8, &target, UCS_UTF16 | UCS_LE);
+        if (!ASSERT_EQ(3, result)) return false;
+    }
+    
+    scf_buffer flat = scf_chain_flatten(&target);
+    bool result = ASSERT_EQ(1 + 10 * UTF16_LEN, flat.size);
+    for (int i = 0; i < 10; i++) {
+        result = result && ASSERT_EQ(0, memcmp(scf_buffer_data(&flat) + 1 + i * UTF16_LEN, utf16_le_encoded_test_data, UTF16_LEN));
+    }
+    
+    static const unsigned char invalid[] = {0x41, 0xC2};
+    size_t invalid_result = ucs_encode_to_chain(scf_buffer_view_wrap(invalid, 2), 0, UCS_UTF8, &target, UCS_UTF8);
+    return result && ASSERT_EQ(SIZE_MAX, invalid_result) && ASSERT_EQ(1 + 10 * UTF16_LEN, target.size);
+}
+
 BEGIN_TEST_GROUP(codec_tests)
 CLEANUP(cleanup)
 TEST(test_valid_utf8_encoding)
@@ -113,5 +132,6 @@ TEST(test_utf8_to_utf16_le)
 TEST(test_utf16_le_to_utf8)
 TEST(test_utf32_le_to_utf8)
 TEST(test_utf8_to_utf32_le)
+TEST(test_utf8_to_utf16_le_chain)
 END_TEST_GROUP
 
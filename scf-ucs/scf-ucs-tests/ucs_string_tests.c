@@ -40,10 +40,54 @@ static bool test_from_cstr(void) {
     ucs_string s = ucs_from_cstr(&op, "1" POUND);
     bool result = ASSERT_EQ(2, s.char_count);
     result &= ASSERT_EQ(4, s.bytes.size);
-    result &= ASSERT_EQ(49, s.bytes.data[0]);
-    result &= ASSERT_EQ(0xc2, s.bytes.data[1]);
-    result &= ASSERT_EQ(0xa3, s.bytes.data[2]);
-    result &= ASSERT_EQ(0, s.bytes.data[3]);
+    result &= ASSERT_EQ(49, scf_buffer_data(&s.bytes)[0]);
+    result &= ASSERT_EQ(0xc2, scf_buffer_data(&s.bytes)[1]);
+    result &= ASSERT_EQ(0xa3, scf_buffer_data(&s.bytes)[2]);
+    result &= ASSERT_EQ(0, scf_buffer_data(&s.bytes)[3]);
+    return result;
+}
+
+static bool test_from_view(void) {
+    scf_buffer_view input = scf_buffer_view_wrap("key=1" POUND ";", 8);
+    ucs_string s = ucs_from_view(&op, scf_buffer_view_extract(input, 4, 3), UCS_UTF8);
+    bool result = ASSERT_EQ(2, s.char_count);
+    result &= ASSERT_EQ(4, s.bytes.size);
+    result &= ASSERT_EQ(0, memcmp("1" POUND, scf_buffer_data(&s.bytes), 4));
+    return result;
+}
+
+static bool test_gap_buffer_round_trip(void) {
+    ucs_string s = ucs_from_cstr(&op, "1" POUND "3");
+    scf_gap_buffer gb = ucs_to_gap_buffer(&op, &s);
+    bool result = ASSERT_EQ(4, scf_gap_buffer_size(&gb));
+    
+    scf_gap_buffer_move_to(&gb, 1);
+    scf_gap_buffer_insert_bytes(&gb, ALAF, 3);
+    ucs_string edited = ucs_from_gap_buffer(&op, &gb);
+    result &= ASSERT_EQ(4, edited.char_count)
+        && ASSERT_EQ(0, strcmp("1" ALAF POUND "3", (const char *)scf_buffer_data(&edited.bytes)));
+    
+    scf_gap_buffer_backspace(&gb, 1);
+    ucs_string invalid = ucs_from_gap_buffer(&op, &gb);
+    return result && ASSERT_FALSE(ucs_is_valid(&invalid));
+}
+
+static bool test_transfer(void) {
+    SCF_OPERATION(scratch);
+    ucs_string s = ucs_from_cstr(&scratch, "a string long enough not to be held inline " POUND);
+    bool result = ASSERT_TRUE(ucs_transfer(&s, &op) == &s);
+    scf_complete(&scratch);
+    result &= ASSERT_EQ(44, s.char_count);
+    ucs_append_char(&s, '!');
+    result &= ASSERT_EQ(0, strcmp("a string long enough not to be held inline " POUND "!", (const char *)scf_buffer_data(&s.bytes)));
+    
+    SCF_OPERATION(budgeted);
+    scf_operation_set_budget(&budgeted, 16, NULL);
+    scf_operation_set_budget_failure(&budgeted, SCF_BUDGET_RETURN_NULL);
+    result = result
+        && ASSERT_TRUE(ucs_transfer(&s, &budgeted) == NULL)
+        && ASSERT_TRUE(s.bytes.operation == &op);
+    scf_complete(&budgeted);
     return result;
 }
 
@@ -62,7 +106,7 @@ static bool test_from_wstr(void) {
     ucs_string s = ucs_from_wstr(&op, input);
     bool result = ASSERT_EQ(3, s.char_count);
     result &= ASSERT_EQ(8, s.bytes.size);
-    result &= ASSERT_EQ(0, memcmp(expected, s.bytes.data, s.bytes.size));
+    result &= ASSERT_EQ(0, memcmp(expected, scf_buffer_data(&s.bytes), s.bytes.size));
     return result;
 }
 
@@ -173,7 +217,10 @@ CLEANUP(cleanup)
 TEST(test_forward_iteration)
 TEST(test_reverse_iteration)
 TEST(test_from_cstr)
+TEST(test_from_view)
 TEST(test_from_wstr)
+TEST(test_gap_buffer_round_trip)
+TEST(test_transfer)
 TEST(test_append)
 TEST(test_substring)
 TEST(test_overlength_substring)
@@ -14,6 +14,8 @@
 #include "err_handling.h"
 #include "machine_info.h"
 
+static const char PROFILE_TAG[] = "ucs_string";
+
 static inline void check_valid(const ucs_string* s) {
 	if (!ucs_is_valid(s)) scf_raise_error(SCF_LOGIC_ERROR, "Specified string is not a valid UTF8 encoding");
 }
@@ -27,24 +29,53 @@ static inline void remove_terminator(ucs_string* s) {
 }
 
 static inline scf_operation* get_operation(const ucs_string* s) {
-	return scf_get_operation(s->bytes.data);
+	return s->bytes.operation;
 }
 
 ucs_string ucs_string_create(scf_operation* op) {
+	scf_profile_push_tag(PROFILE_TAG);
 	ucs_string result = { 0, scf_buffer_create(op, 0) };
 	add_terminator(&result);
+	scf_profile_pop_tag();
 	return result;
 }
 
 ucs_string ucs_from_bytes(scf_operation* op, const void* bytes, size_t bytecount, ucs_encoding enc) {
+	return ucs_from_view(op, scf_buffer_view_wrap(bytes, bytecount), enc);
+}
+
+ucs_string ucs_from_view(scf_operation* op, scf_buffer_view bytes, ucs_encoding enc) {
+	scf_profile_push_tag(PROFILE_TAG);
 	ucs_string result;
-	scf_buffer wrapped_bytes = scf_buffer_wrap((void*)bytes, bytecount);
-	result.bytes = scf_buffer_create(op, bytecount);
-	result.char_count = ucs_encode(&wrapped_bytes, 0, enc, &result.bytes, UCS_UTF8);
+	result.bytes = scf_buffer_create(op, bytes.size);
+	result.char_count = ucs_encode_view(bytes, 0, enc, &result.bytes, UCS_UTF8);
 	add_terminator(&result);
+	scf_profile_pop_tag();
 	return result;
 }
 
+ucs_string ucs_from_gap_buffer(scf_operation* op, const scf_gap_buffer* gb) {
+	ucs_string result = { 0, scf_gap_buffer_to_buffer(gb, op) };
+	scf_buffer_view bytes = scf_buffer_get_view(&result.bytes);
+	size_t index = 0;
+	while (index < bytes.size) {
+		if (ucs_utf8_get_view(bytes, &index) == UCS_INVALID) {
+			result.char_count = SIZE_MAX;
+			break;
+		}
+		
+		result.char_count++;
+	}
+	
+	add_terminator(&result);
+	return result;
+}
+
+scf_gap_buffer ucs_to_gap_buffer(scf_operation* op, const ucs_string* s) {
+	check_valid(s);
+	return scf_gap_buffer_from_view(op, scf_buffer_extract_view(&s->bytes, 0, s->bytes.size - 1));
+}
+
 ucs_string ucs_from_cstr_with_encoding(scf_operation* op, const char* s, ucs_encoding enc) {
 	return ucs_from_bytes(op, s, strlen(s), enc);
 }
@@ -81,31 +112,38 @@ ucs_string ucs_from_wstr(scf_operation* op, const wchar_t* s) {
 
 ucs_string ucs_string_copy(scf_operation* op, const ucs_string* s) {
 	check_valid(s);
-	ucs_string result = *s;
-	size_t bytecount = s->bytes.size;
-	result.bytes.capacity = bytecount;
-	result.bytes.data = scf_alloc(op, bytecount);
-	result.bytes.pinned = false;
-	memcpy(result.bytes.data, s->bytes.data, bytecount);
+	scf_profile_push_tag(PROFILE_TAG);
+	ucs_string result = { s->char_count, scf_buffer_create(op, s->bytes.size) };
+	scf_buffer_append(&result.bytes, &s->bytes);
+	scf_profile_pop_tag();
 	return result;
 }
 
+ucs_string* ucs_transfer(ucs_string* s, scf_operation* op) {
+	return scf_buffer_transfer(&s->bytes, op) ? s : NULL;
+}
+
 void ucs_append(ucs_string* s1, const ucs_string* s2) {
 	check_valid(s1);
 	check_valid(s2);
     remove_terminator(s1);
+	scf_profile_push_tag(PROFILE_TAG);
 	scf_buffer_append(&s1->bytes, &s2->bytes);
+	scf_profile_pop_tag();
 	s1->char_count += s2->char_count;
 }
 
 void ucs_append_char(ucs_string *s, ucs_utf8_char ch) {
     check_valid(s);
     remove_terminator(s);
+    scf_profile_push_tag(PROFILE_TAG);
     ucs_utf8_append(&s->bytes, ch);
     add_terminator(s);
+    scf_profile_pop_tag();
 }
 
 ucs_string ucs_substring(const ucs_iterator* from, size_t length) {
+    scf_profile_push_tag(PROFILE_TAG);
 	ucs_string result = ucs_string_create(get_operation(from->s));
     remove_terminator(&result);
     result.char_count = length;
@@ -122,13 +160,14 @@ ucs_string ucs_substring(const ucs_iterator* from, size_t length) {
 	}
 
     add_terminator(&result);
+    scf_profile_pop_tag();
 	return result;
 }
 
 int ucs_compare(const ucs_string *s1, const ucs_string *s2) {
     check_valid(s1);
     check_valid(s2);
-    int result = strcmp((const char *)s1->bytes.data, (const char *)s2->bytes.data);
+    int result = strcmp((const char *)scf_buffer_data(&s1->bytes), (const char *)scf_buffer_data(&s2->bytes));
     return result;
 }
 
@@ -181,13 +220,13 @@ bool ucs_prev(ucs_iterator *iter, ucs_utf8_char *ch) {
     }
     
     iter->byte_index--;
-    *ch = iter->s->bytes.data[iter->byte_index];
+    *ch = scf_buffer_data(&iter->s->bytes)[iter->byte_index];
     if (*ch <= 0x7F) goto done;
     
     int shift = 8;
     while (true) {
         iter->byte_index--;
-        ucs_utf8_char nextbyte = iter->s->bytes.data[iter->byte_index];
+        ucs_utf8_char nextbyte = scf_buffer_data(&iter->s->bytes)[iter->byte_index];
         *ch |= (nextbyte << shift);
         if ((nextbyte & 0xC0) != 0x80) goto done;
         shift += 8;
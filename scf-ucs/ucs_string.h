@@ -11,6 +11,7 @@
 #include "ucs_db.h"
 #include "mmgt.h"
 #include "codecs.h"
+#include "gap_buffer.h"
 
 /*-------------------------------------------------
  * Holds a UTF8 encoded string.
@@ -42,6 +43,25 @@ ucs_string ucs_string_create(scf_operation *op);
 
 ucs_string ucs_from_bytes(scf_operation *op, const void *bytes, size_t bytecount, ucs_encoding enc);
 
+/*-------------------------------------------------
+ * Creates a string from the bytes in a view, for
+ * example a field sliced from a larger input.
+ ------------------------------------------------*/
+ucs_string ucs_from_view(scf_operation *op, scf_buffer_view bytes, ucs_encoding enc);
+
+/*-------------------------------------------------
+ * Creates a string from the UTF8 contents of a gap
+ * buffer. If they are not valid UTF8 the string's
+ * char_count is SIZE_MAX.
+ ------------------------------------------------*/
+ucs_string ucs_from_gap_buffer(scf_operation *op, const scf_gap_buffer *gb);
+
+/*-------------------------------------------------
+ * Copies the bytes of a string, without its
+ * terminator, into a new gap buffer for editing.
+ ------------------------------------------------*/
+scf_gap_buffer ucs_to_gap_buffer(scf_operation *op, const ucs_string *s);
+
 ucs_string ucs_from_cstr(scf_operation* op, const char* s);
 
 ucs_string ucs_from_wstr(scf_operation* op, const wchar_t* s);
@@ -52,6 +72,16 @@ ucs_string ucs_from_cstr_with_encoding(scf_operation* op, const char* s, ucs_enc
 
 ucs_string ucs_string_copy(scf_operation *op, const ucs_string *s);
 
+/*-------------------------------------------------
+ * Moves a string's bytes into another operation
+ * with scf_transfer. Unlike ucs_string_copy this
+ * does not copy the bytes, unless they were carved
+ * from an arena's slab. Returns the string, or
+ * NULL (leaving it unchanged) if the transfer
+ * fails under SCF_BUDGET_RETURN_NULL.
+ ------------------------------------------------*/
+ucs_string *ucs_transfer(ucs_string *s, scf_operation *op);
+
 void ucs_append(ucs_string *s1, const ucs_string *s2);
 
 void ucs_append_char(ucs_string *s, ucs_utf8_char ch);